@@ -5,21 +5,76 @@
 #include "uci.h"
 #include "zobrist.h"
 
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 using namespace Horsie;
 
+#if defined(FAT_BINARY)
+namespace Horsie {
+    //  Each of a fat binary's targets has its own copy of the engine, and main in dispatch.cpp calls one of them.
+    i32 EngineMain(i32 argc, char* argv[]);
+}
+
+i32 Horsie::EngineMain(i32 argc, char* argv[]) {
+#else
 i32 main(i32 argc, char* argv[]) {
+#endif
+
+    //  A network given with "--evalfile <path>" is loaded instead of the embedded one, which then never has to be
+    //  decompressed. Networks written by exportnet are mapped as they are, so this makes startup much cheaper.
+    //  "--startup-profile" prints how long each step of initialization took.
+    std::string evalFile{};
+    bool profile = false;
+    std::vector<char*> args{};
+    for (i32 i = 0; i < argc; i++) {
+        if (std::string(argv[i]) == "--evalfile" && i + 1 < argc)
+            evalFile = argv[++i];
+        else if (std::string(argv[i]) == "--startup-profile")
+            profile = true;
+        else
+            args.push_back(argv[i]);
+    }
+
+    std::vector<std::pair<std::string, double>> steps{};
+    const auto timeStep = [&](const std::string& name, auto&& step) {
+        const auto start = std::chrono::steady_clock::now();
+        step();
+        steps.push_back({ name, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() });
+    };
 
-    NNUE::LoadNetwork(std::string(EVALFILE));
-    Precomputed::Init();
-    Zobrist::Init();
-    Cuckoo::Init();
+    timeStep("LoadNetwork", [&] {
+        if (evalFile.empty() || !NNUE::LoadNetworkFile(evalFile)) {
+            if (!evalFile.empty())
+                std::cout << "info string failed to load network from " << evalFile << ", using the embedded network" << std::endl;
+
+            NNUE::LoadNetwork(std::string(EVALFILE));
+        }
+    });
+    timeStep("Precomputed::Init", [] { Precomputed::Init(); });
+    timeStep("Zobrist::Init", [] { Zobrist::Init(); });
+    timeStep("Cuckoo::Init", [] { Cuckoo::Init(); });
 
     std::cout << "Horsie " << EngVersion << std::endl << std::endl;
 
-    UCI::UCIClient uci{};
-    uci.InputLoop(argc, argv);
+    //  The client owns the SearchThreadPool, so this is mostly the time taken to start its threads and allocate the TT.
+    std::unique_ptr<UCI::UCIClient> uci{};
+    timeStep("SearchThreadPool", [&] { uci = std::make_unique<UCI::UCIClient>(); });
+
+    if (profile) {
+        double total = 0;
+        for (const auto& [name, ms] : steps) {
+            std::cout << "info string startup " << std::left << std::setw(20) << name << std::fixed << std::setprecision(3) << ms << " ms" << std::endl;
+            total += ms;
+        }
+        std::cout << "info string startup " << std::left << std::setw(20) << "total" << total << " ms" << std::defaultfloat << std::endl;
+    }
+
+    uci->InputLoop(static_cast<i32>(args.size()), args.data());
 
     return 0;
 }
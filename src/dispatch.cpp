@@ -0,0 +1,88 @@
+
+//  The entry point of the fat binary built by "make fat", which contains one copy of the engine for each of FAT_TARGETS.
+//  Every copy is compiled with its own -march and SIMD defines, so the NNUE kernels, network layout and PEXT attack lookups
+//  are all specific to it, and with -DHorsie=Horsie_<target> so that their entry points have different names.
+//  The Makefile hides everything else that a copy defines, so each one only ever calls its own inline functions.
+//  This picks the best copy that the CPU supports using cpuid, and "--target <name>" can be used to force one.
+
+#include "defs.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define DECLARE_TARGET(name) namespace Horsie_##name { i32 EngineMain(i32 argc, char* argv[]); }
+DECLARE_TARGET(V4_VNNI)
+DECLARE_TARGET(V4)
+DECLARE_TARGET(AVXVNNI)
+DECLARE_TARGET(V3)
+DECLARE_TARGET(AVX2_BMI2)
+DECLARE_TARGET(V2)
+#undef DECLARE_TARGET
+
+namespace {
+
+    bool HasV2() {
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("ssse3");
+    }
+
+    bool HasV3() {
+        return HasV2() && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")
+            && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+    }
+
+    bool HasV4() {
+        return HasV3() && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512cd");
+    }
+
+    //  PEXT is microcoded on Zen 1 and 2, so those use the AVX2 build that looks up attacks with magics instead.
+    bool SlowPext() {
+        return __builtin_cpu_is("znver1") || __builtin_cpu_is("znver2");
+    }
+
+    struct FatTarget {
+        const char* Name;
+        bool (*Supported)();
+        i32 (*Main)(i32 argc, char* argv[]);
+    };
+
+    //  In order of preference
+    constexpr FatTarget Targets[] = {
+        { "v4-vnni",   [] { return HasV4() && __builtin_cpu_supports("avx512vnni"); }, Horsie_V4_VNNI::EngineMain },
+        { "v4",        [] { return HasV4(); },                                          Horsie_V4::EngineMain },
+        { "avxvnni",   [] { return HasV3() && __builtin_cpu_supports("avxvnni") && !SlowPext(); }, Horsie_AVXVNNI::EngineMain },
+        { "v3",        [] { return HasV3() && !SlowPext(); },                           Horsie_V3::EngineMain },
+        { "avx2-bmi2", [] { return HasV3(); },                                          Horsie_AVX2_BMI2::EngineMain },
+        { "v2",        [] { return HasV2(); },                                          Horsie_V2::EngineMain },
+    };
+
+}
+
+i32 main(i32 argc, char* argv[]) {
+    __builtin_cpu_init();
+
+    const char* forced = nullptr;
+    std::vector<char*> args{};
+    for (i32 i = 0; i < argc; i++) {
+        if (std::strcmp(argv[i], "--target") == 0 && i + 1 < argc)
+            forced = argv[++i];
+        else
+            args.push_back(argv[i]);
+    }
+
+    for (const auto& target : Targets) {
+        if (forced != nullptr ? std::strcmp(forced, target.Name) != 0 : !target.Supported())
+            continue;
+
+        args.push_back(nullptr);
+        return target.Main(static_cast<i32>(args.size() - 1), args.data());
+    }
+
+    if (forced != nullptr)
+        std::cout << "Unknown target " << forced << ", the choices are v4-vnni, v4, avxvnni, v3, avx2-bmi2 and v2" << std::endl;
+    else
+        std::cout << "This CPU doesn't support any of the targets in this binary, it needs at least SSE4.2 and POPCNT" << std::endl;
+
+    return 1;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "bitboard.h"
+#include "datagen/bullet_format.h"
+#include "defs.h"
+#include "movegen.h"
+#include "nnue/nn.h"
+#include "position.h"
+#include "threadpool.h"
+#include "util.h"
+#include "util/timer.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Horsie {
+
+    //  Only the piece placement and side to move of a FEN matter for evaluation, so this skips everything else
+    //  that Position::LoadFromFEN does. Returns false if either side is missing a king.
+    inline bool ParseBatchFEN(const std::string& fen, NNUE::EvalBatchEntry& entry) {
+        Bitboard& bb = entry.bb;
+        bb.Reset();
+
+        std::istringstream ss(fen);
+        std::string placement{}, stm{};
+        ss >> placement >> stm;
+
+        i32 sq = static_cast<i32>(Square::A8);
+        for (char token : placement) {
+            size_t idx;
+            if (std::isdigit(static_cast<unsigned char>(token)))
+                sq += (token - '0') * EAST;
+
+            else if (token == '/')
+                sq += 2 * SOUTH;
+
+            else if ((idx = PieceToChar.find(static_cast<char>(std::tolower(token)))) != std::string::npos && sq >= 0 && sq < SQUARE_NB) {
+                bb.AddPiece(sq, std::isupper(static_cast<unsigned char>(token)) ? WHITE : BLACK, static_cast<i32>(idx));
+                ++sq;
+            }
+        }
+
+        entry.ToMove = (stm == "b") ? BLACK : WHITE;
+        return (bb.Pieces[KING] & bb.Colors[WHITE]) != 0 && (bb.Pieces[KING] & bb.Colors[BLACK]) != 0;
+    }
+
+    //  Evaluates every position in the input file with NNUE::GetEvaluations, and writes one score per line to the output file.
+    //  Files ending in ".bin" are read as BulletFormatEntry records, which are always from the side to move's point of view,
+    //  and anything else is read as one FEN per line. FENs that can't be evaluated get "none" instead of a score.
+    //  The input is read in blocks, and each block is split between all of the pool's threads.
+    inline void DoEvalBatch(SearchThreadPool& SearchPool, const std::string& inputPath, const std::string& outputPath) {
+        using Datagen::BulletFormatEntry;
+        constexpr size_t BlockSize = 1 << 16;
+
+        const bool isBullet = inputPath.size() >= 4 && inputPath.substr(inputPath.size() - 4) == ".bin";
+
+        std::ifstream input(inputPath, isBullet ? std::ios::binary : std::ios::in);
+        std::ofstream output(outputPath);
+        if (!input || !output) {
+            std::cout << "info string couldn't open " << (!input ? inputPath : outputPath) << std::endl;
+            return;
+        }
+
+        std::vector<NNUE::EvalBatchEntry> entries{};
+        std::vector<BulletFormatEntry> records(BlockSize);
+        std::vector<bool> valid{};
+        entries.reserve(BlockSize);
+
+        u64 total = 0;
+        const auto startTime = Timepoint::Now();
+
+        while (true) {
+            entries.clear();
+            valid.clear();
+
+            if (isBullet) {
+                input.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(BlockSize * sizeof(BulletFormatEntry)));
+                const auto count = static_cast<size_t>(input.gcount()) / sizeof(BulletFormatEntry);
+
+                for (size_t i = 0; i < count; i++) {
+                    NNUE::EvalBatchEntry& entry = entries.emplace_back();
+                    records[i].FillBitboard(entry.bb);
+                    entry.ToMove = WHITE;
+                    valid.push_back(true);
+                }
+            }
+            else {
+                std::string line{};
+                while (valid.size() < BlockSize && std::getline(input, line)) {
+                    NNUE::EvalBatchEntry entry{};
+                    const bool ok = ParseBatchFEN(line, entry);
+                    if (ok)
+                        entries.push_back(entry);
+
+                    valid.push_back(ok);
+                }
+            }
+
+            if (valid.empty())
+                break;
+
+            SearchPool.RunOnAllThreads([&](i32 i, i32 n) {
+                const auto begin = entries.size() * i / n;
+                const auto end = entries.size() * (i + 1) / n;
+                NNUE::GetEvaluations(std::span(entries).subspan(begin, end - begin));
+            });
+
+            std::ostringstream out{};
+            size_t next = 0;
+            for (bool ok : valid) {
+                if (ok)
+                    out << entries[next++].Score << '\n';
+                else
+                    out << "none\n";
+            }
+            output << out.str();
+
+            total += valid.size();
+        }
+
+        const auto duration = std::max<i64>(Timepoint::TimeSince(startTime), 1);
+        std::cout << "Evaluated " << FormatWithCommas(total) << " positions in " << duration << " ms ("
+                  << FormatWithCommas(static_cast<u64>(total * 1000 / duration)) << " pos/sec) with " << SearchPool.Threads.size() << " threads" << std::endl;
+    }
+
+    //  Compares the fixed point layers after the FT with the float ones over the bench positions and every position one legal
+    //  move after them, and prints the largest and average difference between their scores.
+    //  integerLayers is what the IntegerLayers option is set to, which is restored afterwards.
+    inline void DoEvalParity(bool integerLayers) {
+        if (!NNUE::SetIntegerLayers(true)) {
+            std::cout << "info string this network's weights don't fit the integer layers" << std::endl;
+            NNUE::SetIntegerLayers(integerLayers);
+            return;
+        }
+
+        Position pos = Position(InitialFEN);
+        u64 count = 0, totalDiff = 0, differing = 0;
+        i32 maxDiff = 0;
+        std::string maxFEN{};
+
+        const auto compare = [&]() {
+            NNUE::SetIntegerLayers(false);
+            const i32 floatScore = NNUE::GetEvaluation(pos);
+            NNUE::SetIntegerLayers(true);
+            const i32 intScore = NNUE::GetEvaluation(pos);
+
+            const i32 diff = std::abs(floatScore - intScore);
+            if (diff > maxDiff) {
+                maxDiff = diff;
+                maxFEN = pos.GetFEN();
+            }
+
+            count++;
+            totalDiff += static_cast<u64>(diff);
+            differing += (diff != 0);
+        };
+
+        for (std::string fen : BenchFENs) {
+            pos.LoadFromFEN(fen);
+            compare();
+
+            ScoredMove list[MoveListSize];
+            const i32 size = Generate<GenLegal>(pos, list, 0);
+            for (i32 i = 0; i < size; i++) {
+                pos.MakeMove(list[i].move);
+                compare();
+                pos.UnmakeMove(list[i].move);
+            }
+        }
+
+        NNUE::SetIntegerLayers(integerLayers);
+
+        std::cout << "Compared " << count << " positions, " << differing << " had different scores" << std::endl;
+        std::cout << "Average difference " << std::fixed << std::setprecision(3) << (static_cast<double>(totalDiff) / count) << std::defaultfloat << std::endl;
+        std::cout << "Largest difference " << maxDiff << (maxDiff != 0 ? " in " + maxFEN : "") << std::endl;
+    }
+
+}
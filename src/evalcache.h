@@ -0,0 +1,50 @@
+#pragma once
+
+#include "defs.h"
+
+#include <array>
+
+namespace Horsie {
+
+    constexpr i32 EvalCacheSize = 1 << 16;
+
+    //  Remembers the raw network output for recently evaluated positions, so that a position reached again after
+    //  its TT entry was overwritten doesn't need to go through the network a second time.
+    //  Each slot packs the upper 48 bits of the hash together with the 16 bit eval, and is always replaced.
+    class RawEvalCache {
+    public:
+        u64 Probes{};
+        u64 Hits{};
+
+        bool Probe(u64 hash, i16& eval) {
+            Probes++;
+
+            const u64 slot = Table[Index(hash)];
+            if ((slot & KeyMask) != (hash & KeyMask))
+                return false;
+
+            Hits++;
+            eval = static_cast<i16>(slot & ~KeyMask);
+            return true;
+        }
+
+        void Store(u64 hash, i16 eval) {
+            Table[Index(hash)] = (hash & KeyMask) | static_cast<u16>(eval);
+        }
+
+        void Clear() {
+            Table.fill(0);
+        }
+
+        void ResetCounters() {
+            Probes = Hits = 0;
+        }
+
+    private:
+        static constexpr u64 KeyMask = ~0xFFFFULL;
+        static constexpr u64 Index(u64 hash) { return hash & (EvalCacheSize - 1); }
+
+        std::array<u64, EvalCacheSize> Table{};
+    };
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "defs.h"
+#include "nnue/nn.h"
+#include "search_bench.h"
+#include "threadpool.h"
+#include "util.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace Horsie {
+
+    //  Runs a bench to the given depth while counting how often each of the FT's neuron pairs is nonzero, and writes the order
+    //  of the original network's pairs from most to least active to path. The network in use is then reloaded in that order,
+    //  and a second bench shows how many fewer nonzero chunks L1 has to read.
+    //  The node counts of both benches are the same, since reordering the pairs doesn't change any evaluations.
+    //  Returns false if the network couldn't be reordered, which is the case for ones that were mapped from an EvalFile.
+    inline bool DoGenPerm(SearchThreadPool& SearchPool, i32 depth, const std::string& path) {
+        const auto run = [&](const char* label) {
+            NNUE::StartActivationCount();
+            DoBench(SearchPool, depth, true);
+
+            u64 evals = 0;
+            double averageChunks = 0;
+            const auto perm = NNUE::FinishActivationCount(evals, averageChunks);
+
+            std::cout << label << ": " << FormatWithCommas(evals) << " evaluations, " << std::fixed << std::setprecision(2)
+                      << averageChunks << " / " << (2 * NNUE::MainNet.FTPairs / NNUE::L1_CHUNK_PER_32) << " nonzero L1 chunks on average" << std::defaultfloat << std::endl;
+            return perm;
+        };
+
+        const auto perm = run("Before");
+        if (!NNUE::WritePermutation(path, perm)) {
+            std::cout << "info string couldn't write " << path << std::endl;
+            return false;
+        }
+
+        std::cout << "info string wrote the neuron order to " << path << std::endl;
+
+        if (!NNUE::ApplyPermutation(perm)) {
+            std::cout << "info string the network in use can't be reordered" << std::endl;
+            return false;
+        }
+
+        run("After");
+        return true;
+    }
+
+}
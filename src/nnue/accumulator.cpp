@@ -7,10 +7,33 @@
 #include "../position.h"
 
 #include <cassert>
+#include <cstddef>
 
 namespace Horsie::NNUE {
 
-    void AccumulatorStack::MoveNext() {
+    namespace {
+        //  How many cache lines at the start of each FT row to prefetch when a move is made.
+        //  The rest of a row is picked up by the hardware prefetcher once the update starts streaming through it.
+        constexpr i32 PrefetchLines = 1;
+
+        template <typename Arch>
+        void PrefetchRows(const LoadedNetwork<Arch>& nn, const PerspectiveUpdate& update) {
+            const auto FeatureWeights = nn.FTWeights8 ? reinterpret_cast<const std::byte*>(nn.FTWeights8)
+                                                      : reinterpret_cast<const std::byte*>(&nn.Weights->FTWeights[0]);
+            const i32 weightSize = nn.FTWeights8 ? sizeof(i8) : sizeof(i16);
+
+            for (i32 i = 0; i < update.SubCnt; i++)
+                for (i32 line = 0; line < PrefetchLines; line++)
+                    prefetch((void*)&FeatureWeights[update.Subs[i] * weightSize + line * 64]);
+
+            for (i32 i = 0; i < update.AddCnt; i++)
+                for (i32 line = 0; line < PrefetchLines; line++)
+                    prefetch((void*)&FeatureWeights[update.Adds[i] * weightSize + line * 64]);
+        }
+    }
+
+    template <typename Arch>
+    void AccumulatorStack<Arch>::MoveNext() {
         if (++HeadIndex == AccStack.size()) {
             AccStack.emplace_back();
         }
@@ -18,14 +41,16 @@ namespace Horsie::NNUE {
         CurrentAccumulator = &AccStack[HeadIndex];
     }
 
-    void AccumulatorStack::UndoMove() {
+    template <typename Arch>
+    void AccumulatorStack<Arch>::UndoMove() {
         assert(HeadIndex > 0);
         HeadIndex--;
 
         CurrentAccumulator = &AccStack[HeadIndex];
     }
 
-    void AccumulatorStack::MakeMove(const Position& pos, Move m) {
+    template <typename Arch>
+    void AccumulatorStack<Arch>::MakeMove(const Position& pos, Move m) {
         const auto& bb = pos.bb;
 
         MoveNext();
@@ -52,18 +77,20 @@ namespace Horsie::NNUE {
         wUpdate.Clear();
         bUpdate.Clear();
 
-        if (ourPiece == KING && (KingBuckets[moveFrom ^ (56 * us)] != KingBuckets[moveTo ^ (56 * us)])) {
+        //  Castling always changes the main network's king bucket, but not necessarily the small network's,
+        //  and the other branch doesn't move the rook.
+        if (ourPiece == KING && (m.IsCastle() || Arch::KingBuckets[moveFrom ^ (56 * us)] != Arch::KingBuckets[moveTo ^ (56 * us)])) {
             //  We will need to fully refresh our perspective, but we can still do theirs.
             dst->NeedsRefresh[us] = true;
 
             PerspectiveUpdate& theirUpdate = dst->Update[them];
             i32 theirKing = pos.KingSquare(them);
 
-            i32 from = FeatureIndexSingle(us, ourPiece, moveFrom, theirKing, them);
-            i32 to = FeatureIndexSingle(us, ourPiece, moveTo, theirKing, them);
+            i32 from = FeatureIndexSingle<Arch>(us, ourPiece, moveFrom, theirKing, them);
+            i32 to = FeatureIndexSingle<Arch>(us, ourPiece, moveTo, theirKing, them);
 
             if (theirPiece != NONE && !m.IsCastle()) {
-                i32 cap = FeatureIndexSingle(them, theirPiece, moveTo, theirKing, them);
+                i32 cap = FeatureIndexSingle<Arch>(them, theirPiece, moveTo, theirKing, them);
 
                 theirUpdate.PushSubSubAdd(from, cap, to);
             }
@@ -71,10 +98,10 @@ namespace Horsie::NNUE {
                 i32 rookFromSq = moveTo;
                 i32 rookToSq = m.CastlingRookSquare();
 
-                to = FeatureIndexSingle(us, ourPiece, m.CastlingKingSquare(), theirKing, them);
+                to = FeatureIndexSingle<Arch>(us, ourPiece, m.CastlingKingSquare(), theirKing, them);
 
-                i32 rookFrom = FeatureIndexSingle(us, ROOK, rookFromSq, theirKing, them);
-                i32 rookTo = FeatureIndexSingle(us, ROOK, rookToSq, theirKing, them);
+                i32 rookFrom = FeatureIndexSingle<Arch>(us, ROOK, rookFromSq, theirKing, them);
+                i32 rookTo = FeatureIndexSingle<Arch>(us, ROOK, rookToSq, theirKing, them);
 
                 theirUpdate.PushSubSubAddAdd(from, rookFrom, to, rookTo);
             }
@@ -86,14 +113,14 @@ namespace Horsie::NNUE {
             i32 wKing = pos.KingSquare(WHITE);
             i32 bKing = pos.KingSquare(BLACK);
 
-            const auto [wFrom, bFrom] = FeatureIndex(us, ourPiece, moveFrom, wKing, bKing);
-            const auto [wTo, bTo] = FeatureIndex(us, m.IsPromotion() ? m.PromotionTo() : ourPiece, moveTo, wKing, bKing);
+            const auto [wFrom, bFrom] = FeatureIndex<Arch>(us, ourPiece, moveFrom, wKing, bKing);
+            const auto [wTo, bTo] = FeatureIndex<Arch>(us, m.IsPromotion() ? m.PromotionTo() : ourPiece, moveTo, wKing, bKing);
 
             wUpdate.PushSubAdd(wFrom, wTo);
             bUpdate.PushSubAdd(bFrom, bTo);
 
             if (theirPiece != NONE) {
-                const auto [wCap, bCap] = FeatureIndex(them, theirPiece, moveTo, wKing, bKing);
+                const auto [wCap, bCap] = FeatureIndex<Arch>(them, theirPiece, moveTo, wKing, bKing);
 
                 wUpdate.PushSub(wCap);
                 bUpdate.PushSub(bCap);
@@ -101,16 +128,21 @@ namespace Horsie::NNUE {
             else if (m.IsEnPassant()) {
                 i32 idxPawn = moveTo - ShiftUpDir(us);
 
-                const auto [wCap, bCap] = FeatureIndex(them, PAWN, idxPawn, wKing, bKing);
+                const auto [wCap, bCap] = FeatureIndex<Arch>(them, PAWN, idxPawn, wKing, bKing);
 
                 wUpdate.PushSub(wCap);
                 bUpdate.PushSub(bCap);
             }
         }
+
+        //  The feature indices are known now, but the update itself won't happen until this position is evaluated.
+        PrefetchRows(*Net, wUpdate);
+        PrefetchRows(*Net, bUpdate);
     }
 
 
-    void AccumulatorStack::EnsureUpdated(Position& pos) {
+    template <typename Arch>
+    void AccumulatorStack<Arch>::EnsureUpdated(Position& pos) {
 
         for (i32 perspective = 0; perspective < 2; perspective++) {
             //  If the current state is correct for our perspective, no work is needed
@@ -133,19 +165,36 @@ namespace Horsie::NNUE {
                 //  so don't bother and refresh the current one instead
                 RefreshFromCache(pos, perspective);
             }
+            else if (curr + 1 == CurrentAccumulator) {
+                ProcessUpdate(curr, CurrentAccumulator, perspective);
+            }
             else {
-                //  Update incrementally till the current accumulator is correct
-                while (curr != CurrentAccumulator) {
-                    Accumulator* prev = curr;
-                    curr++;
-                    ProcessUpdate(prev, curr, perspective);
-                }
+                //  Several plies are pending, so apply all of them in one pass
+                ProcessUpdates(curr, CurrentAccumulator, perspective);
             }
         }
     }
 
-    void AccumulatorStack::ProcessUpdate(Accumulator* prev, Accumulator* curr, i32 perspective) {
-        auto FeatureWeights = reinterpret_cast<const i16*>(&net.FTWeights[0]);
+    template <typename Arch>
+    void AccumulatorStack<Arch>::ProcessUpdate(Accumulator* prev, Accumulator* curr, i32 perspective) {
+        if (Net->FTWeights8)
+            ProcessUpdate(Net->FTWeights8, prev, curr, perspective);
+        else
+            ProcessUpdate(&Net->Weights->FTWeights[0], prev, curr, perspective);
+    }
+
+    template <typename Arch>
+    void AccumulatorStack<Arch>::ProcessUpdates(Accumulator* from, Accumulator* to, i32 perspective) {
+        if (Net->FTWeights8)
+            ProcessUpdates(Net->FTWeights8, from, to, perspective);
+        else
+            ProcessUpdates(&Net->Weights->FTWeights[0], from, to, perspective);
+    }
+
+    template <typename Arch>
+    template <typename W>
+    void AccumulatorStack<Arch>::ProcessUpdate(const W* FeatureWeights, Accumulator* prev, Accumulator* curr, i32 perspective) {
+        const auto chunks = Net->FTChunks;
         const auto& updates = curr->Update[perspective];
 
         assert(updates.AddCnt != 0 || updates.SubCnt != 0);
@@ -153,18 +202,18 @@ namespace Horsie::NNUE {
         auto src = reinterpret_cast<i16*>(&prev->Sides[perspective]);
         auto dst = reinterpret_cast<i16*>(&curr->Sides[perspective]);
         if (updates.AddCnt == 1 && updates.SubCnt == 1) {
-            SubAdd(src, dst,
+            SubAdd(chunks, src, dst,
                    &FeatureWeights[updates.Subs[0]],
                    &FeatureWeights[updates.Adds[0]]);
         }
         else if (updates.AddCnt == 1 && updates.SubCnt == 2) {
-            SubSubAdd(src, dst,
+            SubSubAdd(chunks, src, dst,
                       &FeatureWeights[updates.Subs[0]],
                       &FeatureWeights[updates.Subs[1]],
                       &FeatureWeights[updates.Adds[0]]);
         }
         else if (updates.AddCnt == 2 && updates.SubCnt == 2) {
-            SubSubAddAdd(src, dst,
+            SubSubAddAdd(chunks, src, dst,
                          &FeatureWeights[updates.Subs[0]],
                          &FeatureWeights[updates.Subs[1]],
                          &FeatureWeights[updates.Adds[0]],
@@ -174,20 +223,64 @@ namespace Horsie::NNUE {
     }
 
 
-    void AccumulatorStack::RefreshIntoCache(Position& pos) {
+    //  Brings every accumulator after 'from' up to and including 'to' up to date in one pass.
+    //  Each tile of the accumulator is loaded from 'from' once and stays in registers while every ply's features are
+    //  removed and added, rather than each ply reading back the previous one's result from memory.
+    //  The intermediate accumulators are still written, since search will return to those plies to try their other moves.
+    template <typename Arch>
+    template <typename W>
+    void AccumulatorStack<Arch>::ProcessUpdates(const W* FeatureWeights, Accumulator* from, Accumulator* to, i32 perspective) {
+        constexpr i32 TileRegs = ACC_TILE_REGS;
+
+        for (i32 tile = 0; tile < Net->FTChunks; tile += TileRegs) {
+            vec_i16 regs[TileRegs];
+
+            const auto src = reinterpret_cast<const vec_i16*>(&from->Sides[perspective]) + tile;
+            for (i32 k = 0; k < TileRegs; k++)
+                regs[k] = src[k];
+
+            for (Accumulator* acc = from + 1; acc <= to; acc++) {
+                const auto& updates = acc->Update[perspective];
+
+                for (i32 i = 0; i < updates.SubCnt; i++) {
+                    const auto weights = &FeatureWeights[updates.Subs[i]];
+                    for (i32 k = 0; k < TileRegs; k++)
+                        regs[k] = vec_sub_epi16(regs[k], LoadFTWeights(weights, tile + k));
+                }
+
+                for (i32 i = 0; i < updates.AddCnt; i++) {
+                    const auto weights = &FeatureWeights[updates.Adds[i]];
+                    for (i32 k = 0; k < TileRegs; k++)
+                        regs[k] = vec_add_epi16(regs[k], LoadFTWeights(weights, tile + k));
+                }
+
+                const auto dst = reinterpret_cast<vec_i16*>(&acc->Sides[perspective]) + tile;
+                for (i32 k = 0; k < TileRegs; k++)
+                    dst[k] = regs[k];
+            }
+        }
+
+        for (Accumulator* acc = from + 1; acc <= to; acc++)
+            acc->Computed[perspective] = true;
+    }
+
+
+    template <typename Arch>
+    void AccumulatorStack<Arch>::RefreshIntoCache(Position& pos) {
         RefreshIntoCache(pos, WHITE);
         RefreshIntoCache(pos, BLACK);
     }
 
-    void AccumulatorStack::RefreshIntoCache(Position& pos, i32 perspective) {
+    template <typename Arch>
+    void AccumulatorStack<Arch>::RefreshIntoCache(Position& pos, i32 perspective) {
         auto accumulator = CurrentAccumulator;
         Bitboard& bb = pos.bb;
 
-        accumulator->Sides[perspective] = net.FTBiases;
-        accumulator->NeedsRefresh[perspective] = false;
-        accumulator->Computed[perspective] = true;
-
         i32 ourKing = pos.KingSquare(perspective);
+
+        i32 adds[32];
+        i32 addCnt = 0;
+
         u64 occ = bb.Occupancy;
         while (occ != 0) {
             i32 pieceIdx = poplsb(occ);
@@ -195,33 +288,36 @@ namespace Horsie::NNUE {
             i32 pt = bb.GetPieceAtIndex(pieceIdx);
             i32 pc = bb.GetColorAtIndex(pieceIdx);
 
-            i32 idx = FeatureIndexSingle(pc, pt, pieceIdx, ourKing, perspective);
-
-            const auto accum = reinterpret_cast<i16*>(&accumulator->Sides[perspective]);
-            const auto weights = &net.FTWeights[idx];
-            Add(accum, accum, weights);
+            adds[addCnt++] = FeatureIndexSingle<Arch>(pc, pt, pieceIdx, ourKing, perspective);
         }
 
-        auto& cache = pos.CachedBuckets[BucketForPerspective(ourKing, perspective)];
+        auto& cache = CachedBuckets[BucketForPerspective<Arch>(ourKing, perspective)];
         auto& entryBB = cache.Boards[perspective];
         auto& entryAcc = cache.accumulator;
 
-        accumulator->CopyTo(entryAcc, perspective);
+        //  Build the accumulator from the biases, and write it into the cache at the same time.
+        ApplyDeltas(*Net, &Net->Weights->FTBiases[0], &accumulator->Sides[perspective][0], &entryAcc.Sides[perspective][0], adds, addCnt, nullptr, 0);
+
+        accumulator->NeedsRefresh[perspective] = false;
+        accumulator->Computed[perspective] = true;
+
+        entryAcc.NeedsRefresh[perspective] = false;
         bb.CopyTo(entryBB);
     }
 
-    void AccumulatorStack::RefreshFromCache(Position& pos, i32 perspective) {
+    template <typename Arch>
+    void AccumulatorStack<Arch>::RefreshFromCache(Position& pos, i32 perspective) {
         auto accumulator = CurrentAccumulator;
         Bitboard& bb = pos.bb;
 
         i32 ourKing = pos.KingSquare(perspective);
 
-        auto& rtEntry = pos.CachedBuckets[BucketForPerspective(ourKing, perspective)];
+        auto& rtEntry = CachedBuckets[BucketForPerspective<Arch>(ourKing, perspective)];
         auto& entryBB = rtEntry.Boards[perspective];
         auto& entryAcc = rtEntry.accumulator;
 
-        auto ourAccumulation = reinterpret_cast<i16*>(&entryAcc.Sides[perspective]);
-        accumulator->NeedsRefresh[perspective] = false;
+        i32 adds[32], subs[32];
+        i32 addCnt = 0, subCnt = 0;
 
         for (i32 pc = 0; pc < COLOR_NB; pc++) {
             for (i32 pt = 0; pt < PIECE_NB; pt++) {
@@ -233,26 +329,36 @@ namespace Horsie::NNUE {
 
                 while (added != 0) {
                     i32 sq = poplsb(added);
-                    i32 idx = FeatureIndexSingle(pc, pt, sq, ourKing, perspective);
-
-                    const auto weights = &net.FTWeights[idx];
-                    Add(ourAccumulation, ourAccumulation, weights);
+                    adds[addCnt++] = FeatureIndexSingle<Arch>(pc, pt, sq, ourKing, perspective);
                 }
 
                 while (removed != 0) {
                     i32 sq = poplsb(removed);
-                    i32 idx = FeatureIndexSingle(pc, pt, sq, ourKing, perspective);
-
-                    const auto weights = &net.FTWeights[idx];
-                    Sub(ourAccumulation, ourAccumulation, weights);
+                    subs[subCnt++] = FeatureIndexSingle<Arch>(pc, pt, sq, ourKing, perspective);
                 }
             }
         }
 
-        entryAcc.CopyTo(accumulator, perspective);
+        //  Update the cached accumulator in place, and write the result into the current one at the same time.
+        auto ourAccumulation = &entryAcc.Sides[perspective][0];
+        ApplyDeltas(*Net, ourAccumulation, ourAccumulation, &accumulator->Sides[perspective][0], adds, addCnt, subs, subCnt);
+
+        accumulator->NeedsRefresh[perspective] = entryAcc.NeedsRefresh[perspective];
         bb.CopyTo(entryBB);
 
         accumulator->Computed[perspective] = true;
     }
 
+    template <typename Arch>
+    void AccumulatorStack<Arch>::ResetCaches() {
+        for (auto& bucket : CachedBuckets) {
+            bucket.accumulator.Sides[WHITE] = bucket.accumulator.Sides[BLACK] = Net->Weights->FTBiases;
+            bucket.Boards[WHITE].Reset();
+            bucket.Boards[BLACK].Reset();
+        }
+    }
+
+    template class AccumulatorStack<MainArch>;
+    template class AccumulatorStack<SmallArch>;
+
 }
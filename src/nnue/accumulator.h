@@ -17,13 +17,18 @@ namespace Horsie {
 
 namespace Horsie::NNUE {
 
+    template <typename Arch> struct LoadedNetwork;
+    extern LoadedNetwork<MainArch> MainNet;
+    extern LoadedNetwork<SmallArch> SmallNet;
+
+    template <typename Arch>
     struct alignas(64) Accumulator {
-        Util::NDArray<i16, 2, L1_SIZE> Sides{};
+        Util::NDArray<i16, 2, Arch::L1_SIZE> Sides{};
         NetworkUpdate Update{};
         std::array<bool, 2> NeedsRefresh = { true, true };
         std::array<bool, 2> Computed = { false, false };
 
-        const std::array<i16, L1_SIZE> operator[](const i32 c) { return Sides[c]; }
+        const std::array<i16, Arch::L1_SIZE> operator[](const i32 c) { return Sides[c]; }
 
         void CopyTo(Accumulator* target) const {
             target->Sides = Sides;
@@ -52,13 +57,27 @@ namespace Horsie::NNUE {
     };
 
 
+    template <typename Arch>
+    struct FinnyTable {
+        Accumulator<Arch> accumulator;
+        std::array<Horsie::Bitboard, 2> Boards = {};
+    };
+
+    template <typename Arch>
+    using BucketCache = std::array<FinnyTable<Arch>, Arch::INPUT_BUCKETS * 2>;
+
+
+    //  The accumulators and refresh cache for one network, which has to stay loaded for as long as the stack exists.
+    template <typename Arch>
     class AccumulatorStack {
     public:
-        AccumulatorStack() : AccStack(256) {
+        using Accumulator = NNUE::Accumulator<Arch>;
+
+        explicit AccumulatorStack(const LoadedNetwork<Arch>& nn) : AccStack(256), Net(&nn) {
             Reset();
         }
         
-        const std::array<i16, L1_SIZE> operator[](const i32 c) { return CurrentAccumulator->Sides[c]; }
+        const std::array<i16, Arch::L1_SIZE> operator[](const i32 c) { return CurrentAccumulator->Sides[c]; }
         
         void Reset() { 
             HeadIndex = 0;
@@ -78,19 +97,22 @@ namespace Horsie::NNUE {
         void RefreshIntoCache(Position& pos);
         void RefreshIntoCache(Position& pos, i32 perspective);
         void RefreshFromCache(Position& pos, i32 perspective);
+        void ResetCaches();
+
+        BucketCache<Arch> CachedBuckets{};
 
     private:
         std::vector<Accumulator> AccStack{};
+        const LoadedNetwork<Arch>* Net{};
         i32 HeadIndex{};
         Accumulator* CurrentAccumulator{};
 
         void ProcessUpdate(Accumulator* prev, Accumulator* curr, i32 perspective);
-    };
+        void ProcessUpdates(Accumulator* from, Accumulator* to, i32 perspective);
 
-    struct FinnyTable {
-        Accumulator accumulator;
-        std::array<Horsie::Bitboard, 2> Boards = {};
+        template <typename W>
+        void ProcessUpdate(const W* FeatureWeights, Accumulator* prev, Accumulator* curr, i32 perspective);
+        template <typename W>
+        void ProcessUpdates(const W* FeatureWeights, Accumulator* from, Accumulator* to, i32 perspective);
     };
-
-    using BucketCache = std::array<FinnyTable, NNUE::INPUT_BUCKETS * 2>;
 }
@@ -4,11 +4,7 @@
 #include "simd.h"
 
 namespace Horsie::NNUE {
-    constexpr auto INPUT_BUCKETS = 14;
     constexpr auto INPUT_SIZE = 768;
-    constexpr auto L1_SIZE = 2048;
-    constexpr auto L2_SIZE = 16;
-    constexpr auto L3_SIZE = 32;
     constexpr auto OUTPUT_BUCKETS = 8;
 
     constexpr auto FT_QUANT = 255;
@@ -30,13 +26,81 @@ namespace Horsie::NNUE {
 
 
     constexpr auto L1_CHUNK_PER_32 = sizeof(i32) / sizeof(i8);
-    constexpr auto L1_PAIR_COUNT = L1_SIZE / 2;
 
-    constexpr auto SIMD_CHUNKS = L1_SIZE / (sizeof(vec_i16) / sizeof(i16));
+    //  How many vectors of an accumulator the refresh and multi-ply update kernels keep in registers at once.
+    //  AVX-512 and NEON have 32 vector registers and AVX2/SSE have 16, and some are left over for the weights being applied.
+#if defined(AVX512) || defined(ARM)
+    constexpr auto ACC_TILE_REGS = 16;
+#else
+    constexpr auto ACC_TILE_REGS = 8;
+#endif
+
+    //  The layer sizes of a network. The FT has FTSize neurons for each of InputBuckets king buckets,
+    //  which are mirrored so that the king is always on files a-d.
+    template <i32 FTSize, i32 L2Size, i32 L3Size, i32 InputBuckets>
+    struct NetworkArch {
+        static constexpr auto INPUT_BUCKETS = InputBuckets;
+        static constexpr auto L1_SIZE = FTSize;
+        static constexpr auto L2_SIZE = L2Size;
+        static constexpr auto L3_SIZE = L3Size;
+
+        static constexpr auto L1_PAIR_COUNT = L1_SIZE / 2;
+        static constexpr auto SIMD_CHUNKS = L1_SIZE / (sizeof(vec_i16) / sizeof(i16));
+
+        static constexpr auto N_FTW = INPUT_SIZE * L1_SIZE * INPUT_BUCKETS;
+
+        //  The accumulator kernels work in whole tiles, and ActivateFT in two vectors of each half at a time.
+        static_assert(SIMD_CHUNKS % ACC_TILE_REGS == 0);
+        static_assert(L1_PAIR_COUNT % (I16_CHUNK_SIZE * 2) == 0);
+        static_assert(L2_SIZE % F32_CHUNK_SIZE == 0 && L3_SIZE % F32_CHUNK_SIZE == 0);
+    };
+
+    //  The network that is embedded and used everywhere.
+    //  KingBuckets gives the cache entry for each king square, where the mirrored buckets are offset by INPUT_BUCKETS.
+    struct MainArch : NetworkArch<2048, 16, 32, 14> {
+        static constexpr i32 KingBuckets[] = {
+             0,  1,  2,  3, 17, 16, 15, 14,
+             4,  5,  6,  7, 21, 20, 19, 18,
+             8,  9, 10, 11, 25, 24, 23, 22,
+             8,  9, 10, 11, 25, 24, 23, 22,
+            12, 12, 13, 13, 27, 27, 26, 26,
+            12, 12, 13, 13, 27, 27, 26, 26,
+            12, 12, 13, 13, 27, 27, 26, 26,
+            12, 12, 13, 13, 27, 27, 26, 26,
+        };
+    };
+
+    //  The optional small network, see SmallNet. It has a single king bucket, and its FT is the narrowest
+    //  that is still a whole number of tiles with AVX-512.
+    struct SmallArch : NetworkArch<512, 16, 32, 1> {
+        static constexpr i32 KingBuckets[] = {
+            0, 0, 0, 0, 1, 1, 1, 1,
+            0, 0, 0, 0, 1, 1, 1, 1,
+            0, 0, 0, 0, 1, 1, 1, 1,
+            0, 0, 0, 0, 1, 1, 1, 1,
+            0, 0, 0, 0, 1, 1, 1, 1,
+            0, 0, 0, 0, 1, 1, 1, 1,
+            0, 0, 0, 0, 1, 1, 1, 1,
+            0, 0, 0, 0, 1, 1, 1, 1,
+        };
+    };
+
+    //  The main network's sizes, which everything that only deals with the main network uses directly.
+    constexpr auto INPUT_BUCKETS = MainArch::INPUT_BUCKETS;
+    constexpr auto L1_SIZE = MainArch::L1_SIZE;
+    constexpr auto L2_SIZE = MainArch::L2_SIZE;
+    constexpr auto L3_SIZE = MainArch::L3_SIZE;
+
+    constexpr auto L1_PAIR_COUNT = MainArch::L1_PAIR_COUNT;
+    constexpr auto SIMD_CHUNKS = MainArch::SIMD_CHUNKS;
+
+    //  The multiple that a network's FT is pruned to, which is a whole number of tiles for both of the halves together.
+    constexpr auto FT_PAIR_ALIGN = ACC_TILE_REGS * I16_CHUNK_SIZE / 2;
+    static_assert(L1_PAIR_COUNT % FT_PAIR_ALIGN == 0 && FT_PAIR_ALIGN % (I16_CHUNK_SIZE * 2) == 0);
 
     constexpr float L1_MUL = (1 << FT_SHIFT) / static_cast<float>(FT_QUANT * FT_QUANT * L1_QUANT);
 
-    constexpr auto N_FTW = INPUT_SIZE * L1_SIZE * INPUT_BUCKETS;
+    constexpr auto N_FTW = MainArch::N_FTW;
     constexpr auto N_FTB = L1_SIZE;
     constexpr auto N_L1W = OUTPUT_BUCKETS * L1_SIZE * L2_SIZE;
     constexpr auto N_L1B = OUTPUT_BUCKETS * L2_SIZE;
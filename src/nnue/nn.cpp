@@ -4,9 +4,27 @@
 #include "../3rdparty/zstd/zstd.h"
 #include "../nnue/simd.h"
 
+#include "../util/alloc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cstring>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #ifdef _MSC_VER
 #define HIDE_MSVC
@@ -20,18 +38,16 @@
 #endif
 
 namespace {
+#if defined(FAT_BINARY) && !defined(FAT_EMBED_NETWORK)
+    //  Only one of a fat binary's targets embeds the network, and the others read the same copy of it.
+    INCBIN_EXTERN(EVAL);
+#else
     INCBIN(EVAL, EVALFILE);
+#endif
 }
 
 namespace Horsie::NNUE {
 
-#if defined(PERM_COUNT)
-    std::array<u64, L1_SIZE> NNZCounts = {};
-    u64 ActivationCount = 0;
-    u64 EvalCalls = 0;
-#endif
-
-
     alignas(64) constexpr std::array<vec_128i, 256> nnzTable = [] {
         std::array<vec_128i, 256> entries = {};
         for (u32 i = 0; i < 256; i++) {
@@ -48,28 +64,819 @@ namespace Horsie::NNUE {
         return entries;
     }();
 
-    Network net;
+    LoadedNetwork<MainArch> MainNet{};
+    LoadedNetwork<SmallArch> SmallNet{};
+
+    namespace {
+        //  Where the weights of MainNet or SmallNet came from.
+        template <typename Arch>
+        struct NetworkSlot {
+            LoadedNetwork<Arch>& Net;
+
+            //  Networks that had to be copied at load time, which are the embedded one, compressed files and small networks.
+            NetworkBase<Arch>* Owned = nullptr;
+            PageKind OwnedKind = PageKind::Normal;
+
+            //  Uncompressed main network files are mapped and used as the weights directly.
+            void* Mapped = nullptr;
+            nuint MappedSize = 0;
+
+            std::string Name{};
+        };
+
+        NetworkSlot<MainArch> MainSlot{ MainNet };
+        NetworkSlot<SmallArch> SmallSlot{ SmallNet };
+
+        /// The order of the main network's neuron pairs, relative to its original order
+        Permutation MainOrder{};
+
+        /// Overrides the order that the next network is loaded with, see ApplyPermutation
+        std::optional<Permutation> PendingPermutation{};
+
+        constexpr Permutation IdentityPermutation = [] {
+            Permutation perm{};
+            for (i32 i = 0; i < L1_PAIR_COUNT; i++)
+                perm[i] = i;
+
+            return perm;
+        }();
+
+        //  Calls fn(begin, end) for ranges of [0, count) on as many threads as there are cores, since it is used on the startup path.
+        template <typename Fn>
+        void ParallelFor(i32 count, Fn&& fn) {
+            const i32 threadCount = std::clamp(static_cast<i32>(std::thread::hardware_concurrency()), 1, 64);
+            const i32 perThread = (count + threadCount - 1) / threadCount;
+
+            std::vector<std::thread> threads{};
+            for (i32 t = 1; t < threadCount; t++)
+                threads.emplace_back(fn, std::min(count, t * perThread), std::min(count, (t + 1) * perThread));
+
+            fn(0, std::min(count, perThread));
+
+            for (auto& th : threads)
+                th.join();
+        }
+
+        //  L1's weights are in groups of L1_CHUNK_PER_32 inputs for each output, see SumL1.
+        constexpr i32 L1WeightOffset(i32 input, i32 output) {
+            return (input / L1_CHUNK_PER_32) * L1_CHUNK_PER_32 * L2_SIZE + output * L1_CHUNK_PER_32 + (input % L1_CHUNK_PER_32);
+        }
+
+        //  Moves neuron pair perm[i] to position i, which is the FT columns i and i + L1_PAIR_COUNT and the L1 inputs
+        //  for both perspectives. This has to happen before InterleaveFT, and doesn't change any evaluations.
+        void PermuteNetwork(Network& nn, const Permutation& perm) {
+            const auto permuteRow = [&](i16* row) {
+                std::array<i16, L1_SIZE> temp{};
+                std::copy_n(row, L1_SIZE, temp.begin());
+
+                for (i32 dst = 0; dst < L1_PAIR_COUNT; dst++) {
+                    row[dst] = temp[perm[dst]];
+                    row[dst + L1_PAIR_COUNT] = temp[perm[dst] + L1_PAIR_COUNT];
+                }
+            };
+
+            ParallelFor(INPUT_SIZE * INPUT_BUCKETS, [&](i32 begin, i32 end) {
+                for (i32 i = begin; i < end; i++)
+                    permuteRow(&nn.FTWeights[i * L1_SIZE]);
+            });
+            permuteRow(&nn.FTBiases[0]);
+
+            for (auto& weights : nn.L1Weights) {
+                const auto temp = weights;
+                for (i32 dst = 0; dst < L1_PAIR_COUNT; dst++) {
+                    for (i32 half : { 0, L1_PAIR_COUNT }) {
+                        for (i32 o = 0; o < L2_SIZE; o++)
+                            weights[L1WeightOffset(dst + half, o)] = temp[L1WeightOffset(perm[dst] + half, o)];
+                    }
+                }
+            }
+        }
+
+        //  Returns the largest value that each FT neuron's accumulator can reach in a legal position, clamped to [0, FT_QUANT].
+        //  Those are bounded by its bias plus its 16 largest positive weights for each color's pieces, taking at most 8 pawns,
+        //  1 king and 10 of each other piece, in whichever input bucket gives the largest sum.
+        std::array<i32, L1_SIZE> LargestActivations(const Network& nn) {
+            using Column = std::array<i16, L1_SIZE>;
+
+            //  Keeps the largest depth values seen in each column in top[0..depth), from largest to smallest. Each row is
+            //  inserted with a pass of max/min over every column, which vectorizes, instead of sorting each column.
+            const auto insert = [](std::vector<Column>& top, const i16* row) {
+                Column carry{};
+                for (i32 c = 0; c < L1_SIZE; c++)
+                    carry[c] = std::max<i16>(row[c], 0);
+
+                for (auto& level : top) {
+                    for (i32 c = 0; c < L1_SIZE; c++) {
+                        const i16 larger = std::max(level[c], carry[c]);
+                        carry[c] = std::min(level[c], carry[c]);
+                        level[c] = larger;
+                    }
+                }
+            };
+
+            std::array<i32, L1_SIZE> largest{};
+            largest.fill(std::numeric_limits<i32>::min());
+
+            for (i32 bucket = 0; bucket < INPUT_BUCKETS; bucket++) {
+                std::array<i32, L1_SIZE> sums{};
+                std::copy(nn.FTBiases.begin(), nn.FTBiases.end(), sums.begin());
+
+                for (i32 color = 0; color < 2; color++) {
+                    std::vector<Column> colorTop(16);
+
+                    for (i32 pt = PAWN; pt <= KING; pt++) {
+                        std::vector<Column> pieceTop((pt == PAWN) ? 8 : (pt == KING) ? 1 : 10);
+
+                        const i32 feature = (bucket * INPUT_SIZE) + (color * 384) + (pt * 64);
+                        for (i32 sq = 0; sq < 64; sq++)
+                            insert(pieceTop, &nn.FTWeights[(feature + sq) * L1_SIZE]);
 
+                        for (const auto& level : pieceTop)
+                            insert(colorTop, level.data());
+                    }
+
+                    for (const auto& level : colorTop)
+                        for (i32 c = 0; c < L1_SIZE; c++)
+                            sums[c] += level[c];
+                }
+
+                for (i32 c = 0; c < L1_SIZE; c++)
+                    largest[c] = std::max(largest[c], sums[c]);
+            }
+
+            for (auto& value : largest)
+                value = std::clamp(value, 0, FT_QUANT);
+
+            return largest;
+        }
+
+        //  Moves the dead neuron pairs in perm to the end, and returns how many pairs the network needs to keep.
+        //  That is rounded up to a multiple of FT_PAIR_ALIGN so that the accumulator kernels still work in whole tiles.
+        i32 PartitionDeadPairs(const Network& nn, Permutation& perm) {
+#if defined(NO_FT_PRUNING)
+            return L1_PAIR_COUNT;
+#else
+            //  A pair's output is (clamp(a, 0, 255) * min(b, 255)) >> 10 for the values a and b of its two halves,
+            //  so it is dead if that is 0 for the largest values that they can reach.
+            const auto largest = LargestActivations(nn);
+            const auto isLive = [&](i32 j) {
+                return ((largest[j] << (16 - FT_SHIFT)) * largest[j + L1_PAIR_COUNT]) >> 16 != 0;
+            };
+
+            const auto live = std::stable_partition(perm.begin(), perm.end(), isLive);
+            const i32 liveCount = static_cast<i32>(live - perm.begin());
+            return std::max<i32>(FT_PAIR_ALIGN, (liveCount + FT_PAIR_ALIGN - 1) / FT_PAIR_ALIGN * FT_PAIR_ALIGN);
+#endif
+        }
+
+        //  Keeps only the first pairs neuron pairs, and moves their second halves from columns [L1_PAIR_COUNT, L1_PAIR_COUNT + pairs)
+        //  to [pairs, 2 * pairs) so that the accumulators only need to update their first 2 * pairs values.
+        //  L1's inputs for the other perspective move the same way, since ActivateFT writes its outputs after the first's.
+        //  Everything after them is zeroed. This has to happen after PermuteNetwork and before InterleaveFT.
+        void PruneFT(Network& nn, i32 pairs) {
+            const auto pruneRow = [&](i16* row) {
+                std::copy_n(row + L1_PAIR_COUNT, pairs, row + pairs);
+                std::fill(row + 2 * pairs, row + L1_SIZE, 0);
+            };
+
+            ParallelFor(INPUT_SIZE * INPUT_BUCKETS, [&](i32 begin, i32 end) {
+                for (i32 i = begin; i < end; i++)
+                    pruneRow(&nn.FTWeights[i * L1_SIZE]);
+            });
+            pruneRow(&nn.FTBiases[0]);
+
+            for (auto& weights : nn.L1Weights) {
+                const auto temp = weights;
+                std::fill(weights.begin(), weights.end(), 0);
+
+                for (i32 j = 0; j < pairs; j++) {
+                    for (i32 o = 0; o < L2_SIZE; o++) {
+                        weights[L1WeightOffset(j, o)] = temp[L1WeightOffset(j, o)];
+                        weights[L1WeightOffset(j + pairs, o)] = temp[L1WeightOffset(j + L1_PAIR_COUNT, o)];
+                    }
+                }
+            }
+        }
+
+        //  Returns whether every FT weight fits in an i8.
+        template <typename Arch>
+        bool FitsI8(const NetworkBase<Arch>& nn) {
+#if defined(NO_I8_FT_WEIGHTS)
+            return false;
+#else
+            std::atomic<bool> fits = true;
+            ParallelFor(INPUT_SIZE * Arch::INPUT_BUCKETS, [&](i32 begin, i32 end) {
+                i16 lo = 0, hi = 0;
+                for (i32 i = begin * Arch::L1_SIZE; i < end * Arch::L1_SIZE; i++) {
+                    lo = std::min(lo, nn.FTWeights[i]);
+                    hi = std::max(hi, nn.FTWeights[i]);
+                }
+
+                if (lo < INT8_MIN || hi > INT8_MAX)
+                    fits = false;
+            });
 
-    void LoadNetwork(const std::string& path) {
+            return fits;
+#endif
+        }
+
+        //  Converts the FT weights to i8 in place, which leaves them in the first half of FTWeights in the same order,
+        //  and zeroes the second half so that exportnet writes it as zeroes. This has to happen after InterleaveFT.
+        //  Each block is read out before it is written over, and a block is never written over one that hasn't been read yet.
+        template <typename Arch>
+        void CompactFT(NetworkBase<Arch>& nn) {
+            constexpr i32 BlockSize = 4096;
+            constexpr i32 N_FTW = Arch::N_FTW;
+            static_assert(N_FTW % BlockSize == 0);
+
+            const auto src = &nn.FTWeights[0];
+            const auto dst = reinterpret_cast<i8*>(&nn.FTWeights[0]);
+
+            std::array<i8, BlockSize> block{};
+            for (i32 i = 0; i < N_FTW; i += BlockSize) {
+                for (i32 j = 0; j < BlockSize; j++)
+                    block[j] = static_cast<i8>(src[i + j]);
+
+                std::copy(block.begin(), block.end(), dst + i);
+            }
+
+            std::fill(dst + N_FTW, dst + 2 * N_FTW, i8(0));
+        }
+
+        //  Uses i8 FT weights for the slot's network if it already has them, or if it is owned and they fit.
+        //  Mapped networks can't be converted, so they keep using their i16 weights unless they were exported with i8 ones.
+        template <typename Arch>
+        void SetFTWeights(NetworkSlot<Arch>& slot, bool isI8) {
+            auto& nn = *slot.Net.Weights;
+            if (!isI8 && slot.Owned == &nn && FitsI8(nn)) {
+                CompactFT(nn);
+                isI8 = true;
+            }
+
+            slot.Net.FTWeights8 = isI8 ? reinterpret_cast<const i8*>(&nn.FTWeights[0]) : nullptr;
+        }
+
+        template <typename Arch>
+        void SetFTPairs(NetworkSlot<Arch>& slot, i32 pairs) {
+            slot.Net.FTPairs = pairs;
+            slot.Net.FTChunks = static_cast<i32>(2 * pairs / I16_CHUNK_SIZE);
+        }
+
+        template <typename Arch>
+        void ReleaseNetwork(NetworkSlot<Arch>& slot) {
+            LargePageFree(slot.Owned, sizeof(NetworkBase<Arch>), slot.OwnedKind);
+            slot.Owned = nullptr;
+
+#if defined(__linux__) || defined(__APPLE__)
+            if (slot.Mapped)
+                munmap(slot.Mapped, slot.MappedSize);
+#endif
+            slot.Mapped = nullptr;
+            slot.MappedSize = 0;
+        }
+
+        //  Allocates a new network, lets fill write its contents, and makes it the one that the slot owns.
+        //  If fill returns false the new network is freed and nullptr is returned, and the slot keeps its previous network.
+        template <typename Arch, typename Fill>
+        NetworkBase<Arch>* FillNetwork(NetworkSlot<Arch>& slot, Fill&& fill) {
+            PageKind kind{};
+            auto dst = LargePageAlloc<NetworkBase<Arch>>(1, kind);
+
+            if (!fill(reinterpret_cast<std::byte*>(dst))) {
+                LargePageFree(dst, sizeof(NetworkBase<Arch>), kind);
+                return nullptr;
+            }
+
+            ReleaseNetwork(slot);
+            slot.Owned = dst;
+            slot.OwnedKind = kind;
+            return dst;
+        }
+
+        template <typename Arch>
+        NetworkBase<Arch>* ReadNetwork(NetworkSlot<Arch>& slot, std::istream& stream) {
+            return FillNetwork(slot, [&](std::byte* dst) {
+                if (IsCompressed(stream))
+                    return LoadZSTD(stream, dst, sizeof(NetworkBase<Arch>));
+
+                stream.read(reinterpret_cast<char*>(dst), sizeof(NetworkBase<Arch>));
+                return static_cast<nuint>(stream.gcount()) == sizeof(NetworkBase<Arch>);
+            });
+        }
+
+        //  Networks that don't come from exportnet need to be laid out for this build after they are read, which puts
+        //  their neuron pairs in the given order with the dead ones pruned, and interleaves their FT weights.
+        void LayOutNetwork(Network& nn, const Permutation& order) {
+            Permutation perm = PendingPermutation ? *PendingPermutation : order;
+            const i32 pairs = PartitionDeadPairs(nn, perm);
+
+            if (perm != IdentityPermutation)
+                PermuteNetwork(nn, perm);
+
+            if (pairs != L1_PAIR_COUNT)
+                PruneFT(nn, pairs);
+
+            InterleaveFT(nn);
+            MainOrder = perm;
+            SetFTPairs(MainSlot, pairs);
+        }
+
+        //  Maps a file that already has this build's layout, so that its weights can be used in place.
+        //  The pages are shared with every other process that maps the same file.
+        Network* MapNetwork(NetworkSlot<MainArch>& slot, const std::string& path, nuint offset) {
+#if defined(__linux__) || defined(__APPLE__)
+            const i32 fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return nullptr;
+
+            const nuint bytes = offset + sizeof(Network);
+            void* mapped = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+
+            if (mapped == MAP_FAILED)
+                return nullptr;
+
+            madvise(mapped, bytes, MADV_WILLNEED);
+
+            ReleaseNetwork(slot);
+            slot.Mapped = mapped;
+            slot.MappedSize = bytes;
+            return reinterpret_cast<Network*>(static_cast<std::byte*>(mapped) + offset);
+#else
+            return nullptr;
+#endif
+        }
+
+        bool CheckBlobHeader(const NetworkBlobHeader& header, const std::string& path) {
+            if (header.Magic != NetworkBlobMagic || header.Version != NetworkBlobVersion || header.NetworkSize != sizeof(Network)) {
+                std::cout << "info string " << path << " is not a network exported by this version" << std::endl;
+                return false;
+            }
+
+            if (std::string(header.Target) != SIMDTarget) {
+                std::cout << "info string " << path << " was exported for " << header.Target << ", but this build uses " << SIMDTarget << std::endl;
+                return false;
+            }
+
+            Permutation order{};
+            std::copy_n(header.Order, L1_PAIR_COUNT, order.begin());
+            if (!IsPermutation(order) || header.FTPairs == 0 || header.FTPairs > L1_PAIR_COUNT || header.FTPairs % FT_PAIR_ALIGN != 0) {
+                std::cout << "info string " << path << " has an invalid neuron order" << std::endl;
+                return false;
+            }
+
+            if (header.FTWeightBytes != 1 && header.FTWeightBytes != 2) {
+                std::cout << "info string " << path << " has an invalid FT weight size" << std::endl;
+                return false;
+            }
+
+            return true;
+        }
+
+
+        //  The optional fixed point path for the layers after the FT, which replaces their float conversions and FMAs.
+        //  L1's sums are already integers in units of 1 / L1_MUL, so its biases are quantized into those units. Its outputs are
+        //  clamped to [0, L1_INT_ONE], squared with vec_madd_epi16, and shifted down by L1_INT_SHIFT with rounding.
+        //  L2's weights are i16 and are multiplied two inputs at a time, and its sums are shifted down so that they can be
+        //  clamped and squared the same way. L3's weights are i16 too, and its sum is scaled back to a score at the end.
+        //  The L2 and L3 weight scales are the largest powers of two for which no sum can overflow, see QuantizeLayers.
+        constexpr double L1_INT_UNIT = 1.0 / L1_MUL;
+        constexpr i32 L1_INT_ONE = static_cast<i32>(L1_INT_UNIT);
+        constexpr i32 L1_INT_SHIFT = 13;
+        constexpr i32 L1_INT_MAX = (L1_INT_ONE * L1_INT_ONE + (1 << (L1_INT_SHIFT - 1))) >> L1_INT_SHIFT;
+        /// The value of an L1 output of 1.0
+        constexpr double L1_INT_SCALE = L1_INT_UNIT * L1_INT_UNIT / (1 << L1_INT_SHIFT);
+
+        /// The value of an L2 sum of 1.0 after it is shifted down, which leaves room to square it in 32 bits
+        constexpr double L2_INT_UNIT = 2 * L1_INT_SCALE;
+        constexpr i32 L2_INT_ONE = static_cast<i32>(L2_INT_UNIT);
+        constexpr i32 L2_INT_SHIFT = 15;
+        constexpr i32 L2_INT_MAX = (L2_INT_ONE * L2_INT_ONE + (1 << (L2_INT_SHIFT - 1))) >> L2_INT_SHIFT;
+        /// The value of an L2 output of 1.0
+        constexpr double L2_INT_SCALE = L2_INT_UNIT * L2_INT_UNIT / (1 << L2_INT_SHIFT);
+
+        //  Below this many bits of precision the weights are considered not to fit, and the float path is used instead.
+        constexpr i32 MinWeightShift = 8;
+
+        struct alignas(64) IntegerLayers {
+            Util::NDArray<i32, OUTPUT_BUCKETS, L2_SIZE> L1Biases;
+            /// Pairs of weights for inputs 2i and 2i + 1, for each output
+            Util::NDArray<i16, OUTPUT_BUCKETS, L2_SIZE * L3_SIZE> L2Weights;
+            Util::NDArray<i32, OUTPUT_BUCKETS, L3_SIZE> L2Biases;
+            /// Sign extended to 32 bits so that vec_madd_epi16 multiplies them by the zero upper halves of L2's outputs
+            Util::NDArray<i32, OUTPUT_BUCKETS, L3_SIZE> L3Weights;
+            std::array<i32, OUTPUT_BUCKETS> L3Biases;
+            /// How far L2's sums are shifted down to be in units of L2_INT_UNIT
+            i32 L2SumShift;
+            /// Multiplies L3's sum to give a score, as a 32.32 fixed point number
+            i64 OutputMul;
+        };
+
+        IntegerLayers IntLayers{};
+        bool IntLayersFit = false;
+        bool IntLayersRequested = false;
+        bool UseIntLayers = false;
+
+        //  How often each neuron pair was nonzero while genperm was counting, for either perspective.
+        //  Each thread that evaluates counts into its own set, and they are only read or reset while the threads are idle.
+        struct ActivationCounts {
+            std::array<u64, L1_PAIR_COUNT> Pairs{};
+            u64 Evals{};
+            u64 Chunks{};
+        };
+
+        std::mutex CountsLock{};
+        std::vector<std::unique_ptr<ActivationCounts>> AllCounts{};
+        bool CountingActivations = false;
+
+        void CountActivations(const i8* ft_outputs, const u16* nnzIndices, i32 nnzCount) {
+            thread_local ActivationCounts* counts = nullptr;
+            if (counts == nullptr) {
+                std::lock_guard lock(CountsLock);
+                counts = AllCounts.emplace_back(std::make_unique<ActivationCounts>()).get();
+            }
+
+            //  Only the nonzero chunks can have active neurons in them.
+            for (i32 i = 0; i < nnzCount; i++) {
+                for (i32 j = 0; j < static_cast<i32>(L1_CHUNK_PER_32); j++) {
+                    const i32 neuron = nnzIndices[i] * L1_CHUNK_PER_32 + j;
+                    counts->Pairs[neuron % MainNet.FTPairs] += (ft_outputs[neuron] != 0);
+                }
+            }
+
+            counts->Evals++;
+            counts->Chunks += static_cast<u64>(nnzCount);
+        }
+
+        //  Returns the largest shift in [MinWeightShift, maxShift] for which fits is true, or -1 if there isn't one.
+        template <typename Fits>
+        i32 LargestShift(i32 maxShift, Fits&& fits) {
+            for (i32 shift = maxShift; shift >= MinWeightShift; shift--) {
+                if (fits(shift))
+                    return shift;
+            }
+
+            return -1;
+        }
+
+        i64 Quantize(double v, double scale) {
+            return static_cast<i64>(std::llround(v * scale));
+        }
+
+        //  Fills IntLayers from the float weights of the main network, which has to be redone whenever it changes.
+        //  The small network always uses the float layers.
+        void QuantizeLayers() {
+            auto& q = IntLayers;
+            const Network* net = MainNet.Weights;
+
+            const i32 l2Shift = LargestShift(15, [&](i32 shift) {
+                for (i32 b = 0; b < OUTPUT_BUCKETS; b++) {
+                    for (i32 j = 0; j < L3_SIZE; j++) {
+                        i64 bound = std::abs(Quantize(net->L2Biases[b][j], L1_INT_SCALE * (1 << shift)));
+                        for (i32 i = 0; i < L2_SIZE; i++) {
+                            const i64 w = Quantize(net->L2Weights[b][i * L3_SIZE + j], 1 << shift);
+                            if (std::abs(w) > INT16_MAX)
+                                return false;
+
+                            bound += std::abs(w) * L1_INT_MAX;
+                        }
+
+                        if (bound > INT32_MAX)
+                            return false;
+                    }
+                }
+                return true;
+            });
+
+            const i32 l3Shift = LargestShift(24, [&](i32 shift) {
+                for (i32 b = 0; b < OUTPUT_BUCKETS; b++) {
+                    i64 bound = std::abs(Quantize(net->L3Biases[b], L2_INT_SCALE * (1 << shift)));
+                    for (i32 j = 0; j < L3_SIZE; j++) {
+                        const i64 w = Quantize(net->L3Weights[b][j], 1 << shift);
+                        if (std::abs(w) > INT16_MAX)
+                            return false;
+
+                        bound += std::abs(w) * L2_INT_MAX;
+                    }
+
+                    if (bound > INT32_MAX)
+                        return false;
+                }
+                return true;
+            });
+
+            IntLayersFit = (l2Shift != -1 && l3Shift != -1);
+            UseIntLayers = IntLayersRequested && IntLayersFit;
+            if (!IntLayersFit)
+                return;
+
+            for (i32 b = 0; b < OUTPUT_BUCKETS; b++) {
+                for (i32 i = 0; i < L2_SIZE; i++)
+                    q.L1Biases[b][i] = static_cast<i32>(Quantize(net->L1Biases[b][i], L1_INT_UNIT));
+
+                for (i32 i = 0; i < L2_SIZE; i++) {
+                    for (i32 j = 0; j < L3_SIZE; j++)
+                        q.L2Weights[b][((i / 2) * L3_SIZE + j) * 2 + (i % 2)] = static_cast<i16>(Quantize(net->L2Weights[b][i * L3_SIZE + j], 1 << l2Shift));
+                }
+
+                for (i32 j = 0; j < L3_SIZE; j++) {
+                    q.L2Biases[b][j] = static_cast<i32>(Quantize(net->L2Biases[b][j], L1_INT_SCALE * (1 << l2Shift)));
+                    q.L3Weights[b][j] = static_cast<i32>(Quantize(net->L3Weights[b][j], 1 << l3Shift));
+                }
+
+                q.L3Biases[b] = static_cast<i32>(Quantize(net->L3Biases[b], L2_INT_SCALE * (1 << l3Shift)));
+            }
+
+            //  L2's sums are in units of L1_INT_SCALE << l2Shift, and L2_INT_UNIT is twice L1_INT_SCALE.
+            q.L2SumShift = l2Shift - 1;
+            q.OutputMul = Quantize(OutputScale * 4294967296.0 / (L2_INT_SCALE * (1 << l3Shift)), 1.0);
+        }
+    }
+
+
+    namespace {
+        //  Loads the network in the file at path as the main network, see LoadNetworkFile.
+        bool LoadFile(NetworkSlot<MainArch>& slot, const std::string& path) {
+            std::ifstream stream(path, std::ios::binary | std::ios::ate);
+            if (!stream)
+                return false;
+
+            const auto fileSize = static_cast<nuint>(stream.tellg());
+            stream.seekg(0);
+
+            Network* loaded = nullptr;
+            bool isI8 = false;
+            const bool compressed = IsCompressed(stream);
+            if (!compressed && fileSize == sizeof(NetworkBlobHeader) + sizeof(Network)) {
+                NetworkBlobHeader header{};
+                stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+                if (!CheckBlobHeader(header, path))
+                    return false;
+
+                Permutation order{};
+                std::copy_n(header.Order, L1_PAIR_COUNT, order.begin());
+                isI8 = (header.FTWeightBytes == 1);
+
+                loaded = MapNetwork(slot, path, sizeof(NetworkBlobHeader));
+
+                //  Without mmap, the file is still read as it is.
+                if (!loaded) {
+                    stream.seekg(static_cast<std::streamoff>(sizeof(NetworkBlobHeader)));
+                    loaded = ReadNetwork(slot, stream);
+                    if (!loaded)
+                        return false;
+                }
+
+                MainOrder = order;
+                SetFTPairs(slot, static_cast<i32>(header.FTPairs));
+            }
+            else if (compressed || fileSize == sizeof(Network)) {
+                //  Headerless files have the trainer's layout like compressed ones do, so they are copied and laid out too.
+                Permutation order = IdentityPermutation;
+                if (ReadPermutation(path + ".perm", order))
+                    std::cout << "info string using the neuron order in " << path << ".perm" << std::endl;
+
+                loaded = ReadNetwork(slot, stream);
+                if (!loaded)
+                    return false;
+
+                LayOutNetwork(*loaded, order);
+            }
+            else {
+                return false;
+            }
+
+            slot.Net.Weights = loaded;
+            slot.Name = path;
+            SetFTWeights(slot, isI8);
+            return true;
+        }
+    }
+
+    //  Returns false and keeps the current network if the embedded one couldn't be decoded.
+    bool LoadNetwork(const std::string& path) {
 
 #if defined(VS_COMP)
         std::ifstream stream(path, std::ios::binary);
+        Network* loaded = ReadNetwork(MainSlot, stream);
 #else
-        std::istringstream stream(std::string(reinterpret_cast<const char*>(gEVALData), gEVALSize));
+        //  Decode straight out of the embedded data, rather than copying it into a stream first.
+        const auto data = reinterpret_cast<const std::byte*>(gEVALData);
+        const auto size = static_cast<nuint>(gEVALSize);
+
+        Network* loaded = FillNetwork(MainSlot, [&](std::byte* dst) {
+            if (IsCompressed(data, size))
+                return LoadZSTD(data, size, dst, sizeof(Network));
+
+            std::memcpy(dst, data, std::min<nuint>(size, sizeof(Network)));
+            return size >= sizeof(Network);
+        });
 #endif
+        if (!loaded) {
+            std::cout << "info string failed to decode the embedded network" << std::endl;
+            return false;
+        }
+
+        MainNet.Weights = loaded;
+        LayOutNetwork(*MainNet.Weights, PermuteIndices);
+        MainSlot.Name = {};
+        SetFTWeights(MainSlot, false);
+        QuantizeLayers();
+        return true;
+    }
+
+    //  Switches to the network in the file at path, or back to the embedded one if path is empty.
+    //  Files written by exportnet are mapped without being copied, since they already have this build's layout, which their
+    //  header is checked for and which records their order. Every other file is copied and laid out like the embedded
+    //  network is, decompressing it first if needed, with its neuron pairs in the order given by "<path>.perm" if that
+    //  exists (see genperm). Headerless uncompressed files have to be exactly sizeof(Network).
+    bool LoadNetworkFile(const std::string& path) {
+        if (path.empty())
+            return LoadNetwork(std::string(EVALFILE));
+
+        if (!LoadFile(MainSlot, path))
+            return false;
 
-        const auto dst = reinterpret_cast<std::byte*>(&net);
+        QuantizeLayers();
+        return true;
+    }
+
+    //  Small networks are always copied, since they are small enough that mapping them wouldn't save anything.
+    //  They are read like the embedded network is, and have their FT interleaved but are never permuted or pruned.
+    //  There is no embedded one, so an empty path leaves SmallNet without weights, and search only uses the main network.
+    bool LoadSmallNetworkFile(const std::string& path) {
+        if (path.empty()) {
+            ReleaseNetwork(SmallSlot);
+            SmallSlot.Name = {};
+            SmallNet = {};
+            return true;
+        }
+
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream)
+            return false;
+
+        const auto fileSize = static_cast<nuint>(stream.tellg());
+        stream.seekg(0);
+
+        if (!IsCompressed(stream) && fileSize != sizeof(SmallNetwork))
+            return false;
+
+        SmallNetwork* loaded = ReadNetwork(SmallSlot, stream);
+        if (!loaded)
+            return false;
+
+        SmallNet.Weights = loaded;
+        InterleaveFT(*SmallNet.Weights);
+
+        SmallSlot.Name = path;
+        SetFTWeights(SmallSlot, false);
+        return true;
+    }
+
+    bool HasSmallNetwork() {
+        return SmallNet.Weights != nullptr;
+    }
+
+    //  Writes the main network with the layout it has in memory, so that loading it later needs neither
+    //  decompression, PermuteNetwork nor InterleaveFT. The header records the SIMD target, since that layout depends on it,
+    //  the order of the neuron pairs so that genperm can work out the order of the original network,
+    //  and whether the FT weights are i8 so that they can be mapped and used as they are.
+    bool ExportNetwork(const std::string& path) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        NetworkBlobHeader header{};
+        header.Magic = NetworkBlobMagic;
+        header.Version = NetworkBlobVersion;
+        header.NetworkSize = sizeof(Network);
+        header.FTPairs = static_cast<u32>(MainNet.FTPairs);
+        header.FTWeightBytes = MainNet.FTWeights8 ? 1 : 2;
+        std::strncpy(header.Target, SIMDTarget, sizeof(header.Target) - 1);
+        std::copy(MainOrder.begin(), MainOrder.end(), header.Order);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(MainNet.Weights), sizeof(Network));
+        return file.good();
+    }
+
+    const std::string& NetworkName() {
+        return MainSlot.Name;
+    }
+
+    bool IsNetworkMapped() {
+        return MainSlot.Mapped != nullptr;
+    }
+
+    bool IsPermutation(const Permutation& perm) {
+        std::array<bool, L1_PAIR_COUNT> seen{};
+        for (i32 i : perm) {
+            if (i < 0 || i >= L1_PAIR_COUNT || seen[i])
+                return false;
+
+            seen[i] = true;
+        }
+
+        return true;
+    }
+
+    //  Reads a permutation written by WritePermutation, which is L1_PAIR_COUNT indices separated by commas or whitespace.
+    bool ReadPermutation(const std::string& path, Permutation& perm) {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+
+        Permutation read{};
+        i32 count = 0;
+        std::string token{};
+        while (file >> token) {
+            token.erase(std::remove(token.begin(), token.end(), ','), token.end());
+            if (token.empty())
+                continue;
+
+            if (count == L1_PAIR_COUNT || !std::all_of(token.begin(), token.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+                return false;
 
-        if (IsCompressed(stream)) {
-            LoadZSTD(stream, dst);
+            read[count++] = std::stoi(token);
         }
-        else {
-            stream.read(reinterpret_cast<char*>(dst), sizeof(Network));
+
+        if (count != L1_PAIR_COUNT || !IsPermutation(read))
+            return false;
+
+        perm = read;
+        return true;
+    }
+
+    //  Writes the permutation in rows of 16, which is the same format as BestPermuteIndices.
+    bool WritePermutation(const std::string& path, const Permutation& perm) {
+        std::ofstream file(path);
+        for (i32 i = 0; i < L1_PAIR_COUNT; i++)
+            file << perm[i] << (i % 16 == 15 ? ",\n" : ", ");
+
+        return file.good();
+    }
+
+    //  Reloads the main network with its neuron pairs in the given order. Returns false if the network couldn't be
+    //  reloaded, or if it is one that was exported or mapped and so can't be reordered.
+    bool ApplyPermutation(const Permutation& perm) {
+        PendingPermutation = perm;
+
+        const bool loaded = MainSlot.Name.empty() ? LoadNetwork(std::string(EVALFILE)) : LoadNetworkFile(MainSlot.Name);
+
+        PendingPermutation.reset();
+        return loaded && MainOrder == perm;
+    }
+
+    void StartActivationCount() {
+        std::lock_guard lock(CountsLock);
+        for (auto& counts : AllCounts)
+            *counts = {};
+
+        CountingActivations = true;
+    }
+
+    Permutation FinishActivationCount(u64& evals, double& averageChunks) {
+        CountingActivations = false;
+
+        std::lock_guard lock(CountsLock);
+        ActivationCounts total{};
+        for (const auto& counts : AllCounts) {
+            for (i32 i = 0; i < L1_PAIR_COUNT; i++)
+                total.Pairs[i] += counts->Pairs[i];
+
+            total.Evals += counts->Evals;
+            total.Chunks += counts->Chunks;
         }
 
-        auto ws = reinterpret_cast<vec_128i*>(&net.FTWeights);
-        auto bs = reinterpret_cast<vec_128i*>(&net.FTBiases);
+        evals = total.Evals;
+        averageChunks = static_cast<double>(total.Chunks) / std::max<u64>(evals, 1);
+
+        //  The counts are for the positions that the pairs are in now, so the sorted positions are mapped back to
+        //  the network's original order.
+        Permutation positions = IdentityPermutation;
+        std::stable_sort(positions.begin(), positions.end(), [&](i32 a, i32 b) { return total.Pairs[a] > total.Pairs[b]; });
+
+        Permutation perm{};
+        for (i32 i = 0; i < L1_PAIR_COUNT; i++)
+            perm[i] = MainOrder[positions[i]];
+
+        return perm;
+    }
+
+    bool SetIntegerLayers(bool enabled) {
+        IntLayersRequested = enabled;
+        UseIntLayers = IntLayersRequested && IntLayersFit;
+        return UseIntLayers;
+    }
+
+    //  Reorders the FT weights and biases in groups of 128 bits so that they match the order that
+    //  vec_packus_epi16 leaves its outputs in, which avoids having to permute them during inference.
+    //  The weights are split between as many threads as there are cores, since this is on the startup path.
+    template <typename Arch>
+    void InterleaveFT(NetworkBase<Arch>& nn) {
+        auto ws = reinterpret_cast<vec_128i*>(&nn.FTWeights);
+        auto bs = reinterpret_cast<vec_128i*>(&nn.FTBiases);
         const i32 numChunks = sizeof(vec_128i) / sizeof(i16);
 #if defined(AVX512)
         const i32 numRegi = 8;
@@ -81,48 +888,34 @@ namespace Horsie::NNUE {
         const i32 numRegi = 2;
         constexpr i32 order[] = { 0, 1 };
 #endif
-        vec_128i regi[numRegi] = {};
 
-        for (i32 i = 0; i < N_FTW / numChunks; i += numRegi) {
-            for (i32 j = 0; j < numRegi; j++)
-                regi[j] = ws[i + j];
+        const auto shuffle = [&](vec_128i* vs, i32 begin, i32 end) {
+            vec_128i regi[numRegi] = {};
 
-            for (i32 j = 0; j < numRegi; j++)
-                ws[i + j] = regi[order[j]];
-        }
+            for (i32 i = begin; i < end; i += numRegi) {
+                for (i32 j = 0; j < numRegi; j++)
+                    regi[j] = vs[i + j];
 
-        for (i32 i = 0; i < L1_SIZE / numChunks; i += numRegi) {
-            for (i32 j = 0; j < numRegi; j++)
-                regi[j] = bs[i + j];
-
-            for (i32 j = 0; j < numRegi; j++)
-                bs[i + j] = regi[order[j]];
-        }
-    }
-
-    i32 GetEvaluation(Position& pos) {
-        const auto occ = popcount(pos.bb.Occupancy);
-        const auto outputBucket = (occ - 2) / ((32 + OUTPUT_BUCKETS - 1) / OUTPUT_BUCKETS);
+                for (i32 j = 0; j < numRegi; j++)
+                    vs[i + j] = regi[order[j]];
+            }
+        };
 
-        return GetEvaluation(pos, outputBucket);
+        ParallelFor(Arch::N_FTW / numChunks / numRegi, [&](i32 begin, i32 end) {
+            shuffle(ws, begin * numRegi, end * numRegi);
+        });
+        shuffle(bs, 0, Arch::L1_SIZE / numChunks);
     }
 
-    i32 GetEvaluation(Position& pos, i32 outputBucket) {
-        const auto accumulator = pos.CurrAccumulator();
-        pos.Accumulators.EnsureUpdated(pos);
-
-        const auto us = Span<i16>(accumulator->Sides[pos.ToMove]);
-        const auto them = Span<i16>(accumulator->Sides[Not(pos.ToMove)]);
-
-        i8 ft_outputs[L1_SIZE];
-        float L1Outputs[L2_SIZE];
-        float L2Outputs[L3_SIZE];
-        float L3Output = 0;
+    namespace {
 
-        i32 nnzCount = 0;
-        u16 nnzIndices[L1_SIZE / L1_CHUNK_PER_32];
+        //  Writes the FT activations for a pair of accumulators into ft_outputs,
+        //  and the indices of the 4 byte chunks of them that are nonzero into nnzIndices. Returns how many there were.
+        template <typename Arch>
+        inline i32 ActivateFT(const LoadedNetwork<Arch>& nn, const i16* us, const i16* them, i8* ft_outputs, u16* nnzIndices) {
+            const i32 FTPairs = nn.FTPairs;
+            i32 nnzCount = 0;
 
-        {
             const auto zero = vec_setzero_epi16();
             const auto one = vec_set1_epi16(FT_QUANT);
 
@@ -132,12 +925,12 @@ namespace Horsie::NNUE {
             vec_128i baseVec = vec128_setzero_si128();
 
             for (const auto acc : { us, them }) {
-                for (i32 i = 0; i < L1_PAIR_COUNT; i += (I16_CHUNK_SIZE * 2)) {
+                for (i32 i = 0; i < FTPairs; i += (I16_CHUNK_SIZE * 2)) {
                     const auto input0a = vec_load_epi16(reinterpret_cast<const vec_i16*>(&acc[i + 0 * I16_CHUNK_SIZE + 0]));
                     const auto input0b = vec_load_epi16(reinterpret_cast<const vec_i16*>(&acc[i + 1 * I16_CHUNK_SIZE + 0]));
 
-                    const auto input1a = vec_load_epi16(reinterpret_cast<const vec_i16*>(&acc[i + 0 * I16_CHUNK_SIZE + L1_PAIR_COUNT]));
-                    const auto input1b = vec_load_epi16(reinterpret_cast<const vec_i16*>(&acc[i + 1 * I16_CHUNK_SIZE + L1_PAIR_COUNT]));
+                    const auto input1a = vec_load_epi16(reinterpret_cast<const vec_i16*>(&acc[i + 0 * I16_CHUNK_SIZE + FTPairs]));
+                    const auto input1b = vec_load_epi16(reinterpret_cast<const vec_i16*>(&acc[i + 1 * I16_CHUNK_SIZE + FTPairs]));
 
                     const auto clipped0a = vec_min_epi16(vec_max_epi16(input0a, zero), one);
                     const auto clipped0b = vec_min_epi16(vec_max_epi16(input0b, zero), one);
@@ -163,35 +956,51 @@ namespace Horsie::NNUE {
                     }
                 }
 
-                offset += L1_PAIR_COUNT;
+                offset += FTPairs;
             }
 
-#if defined(PERM_COUNT)
-            EvalCalls++;
-            ActivationCount += static_cast<u64>(nnzCount);
-            for (i32 i = 0; i < L1_SIZE; i++)
-                NNZCounts[i] += (ft_outputs[i] ? 1UL : 0);
-#endif
+            return nnzCount;
         }
 
+        //  Writes L1's sums over the nonzero FT outputs into sums, which are in units of 1 / L1_MUL.
+        template <typename Arch>
+        inline void SumL1(const NetworkBase<Arch>& nn, const i8* ft_outputs, const u16* nnzIndices, i32 nnzCount, i32 outputBucket, vec_i32* sums) {
+            constexpr auto L2_SIZE = Arch::L2_SIZE;
+            const auto& weights = nn.L1Weights[outputBucket];
+
+            //  With only one or two vectors of outputs, a single set of sums would make every vpdpbusd wait on the previous one,
+            //  so the nonzero inputs are split between several independent sets that are added together at the end.
+            constexpr i32 SUM_SETS = 4;
+            vec_i32 partials[SUM_SETS][L2_SIZE / I32_CHUNK_SIZE]{};
+
+            const auto inputs32 = reinterpret_cast<const i32*>(ft_outputs);
+            i32 i = 0;
+            for (; i + SUM_SETS <= nnzCount; i += SUM_SETS) {
+                for (i32 set = 0; set < SUM_SETS; set++) {
+                    const auto index = nnzIndices[i + set];
+                    const auto input32 = vec_set1_epi32(inputs32[index]);
+                    const auto weight = reinterpret_cast<const vec_i8*>(&weights[index * L1_CHUNK_PER_32 * L2_SIZE]);
+                    for (i32 k = 0; k < L2_SIZE / F32_CHUNK_SIZE; k++)
+                        partials[set][k] = vec_dpbusd_epi32(partials[set][k], input32, weight[k]);
+                }
+            }
 
-        {
-            const auto inputs = Span<i8>(ft_outputs);
-            const auto& weights = net.L1Weights[outputBucket];
-            const auto& biases = net.L1Biases[outputBucket];
-            const auto outputs = L1Outputs;
-
-            vec_i32 sums[L2_SIZE / I32_CHUNK_SIZE]{};
-
-            const auto inputs32 = (i32*)(inputs.data());
-            for (i32 i = 0; i < nnzCount; i++) {
+            for (; i < nnzCount; i++) {
                 const auto index = nnzIndices[i];
                 const auto input32 = vec_set1_epi32(inputs32[index]);
                 const auto weight = reinterpret_cast<const vec_i8*>(&weights[index * L1_CHUNK_PER_32 * L2_SIZE]);
                 for (i32 k = 0; k < L2_SIZE / F32_CHUNK_SIZE; k++)
-                    sums[k] = vec_dpbusd_epi32(sums[k], input32, weight[k]);
+                    partials[0][k] = vec_dpbusd_epi32(partials[0][k], input32, weight[k]);
             }
 
+            for (i32 k = 0; k < L2_SIZE / I32_CHUNK_SIZE; k++)
+                sums[k] = vec_add_epi32(vec_add_epi32(partials[0][k], partials[1][k]), vec_add_epi32(partials[2][k], partials[3][k]));
+        }
+
+        template <typename Arch>
+        inline void ActivateL1(const NetworkBase<Arch>& nn, const vec_i32* sums, i32 outputBucket, float* outputs) {
+            constexpr auto L2_SIZE = Arch::L2_SIZE;
+            const auto& biases = nn.L1Biases[outputBucket];
             const auto sumMul = vec_set1_ps(L1_MUL);
 
             const auto zero = vec_set1_ps(0.0f);
@@ -205,12 +1014,12 @@ namespace Horsie::NNUE {
             }
         }
 
-
-        {
-            const auto inputs = L1Outputs;
-            const auto& weights = net.L2Weights[outputBucket];
-            const auto& biases = net.L2Biases[outputBucket];
-            const auto outputs = L2Outputs;
+        template <typename Arch>
+        inline void ForwardL2(const NetworkBase<Arch>& nn, const float* inputs, i32 outputBucket, float* outputs) {
+            constexpr auto L2_SIZE = Arch::L2_SIZE;
+            constexpr auto L3_SIZE = Arch::L3_SIZE;
+            const auto& weights = nn.L2Weights[outputBucket];
+            const auto& biases = nn.L2Biases[outputBucket];
 
             vec_ps sumVecs[L3_SIZE / F32_CHUNK_SIZE];
 
@@ -233,11 +1042,11 @@ namespace Horsie::NNUE {
             }
         }
 
-
-        {
-            const auto& inputs = L2Outputs;
-            const auto& weights = net.L3Weights[outputBucket];
-            const auto bias = net.L3Biases[outputBucket];
+        template <typename Arch>
+        inline float ForwardL3(const NetworkBase<Arch>& nn, const float* inputs, i32 outputBucket) {
+            constexpr auto L3_SIZE = Arch::L3_SIZE;
+            const auto& weights = nn.L3Weights[outputBucket];
+            const auto bias = nn.L3Biases[outputBucket];
 
             constexpr auto SUM_COUNT = 64 / sizeof(vec_ps);
             vec_ps sumVecs[SUM_COUNT]{};
@@ -248,13 +1057,187 @@ namespace Horsie::NNUE {
                 sumVecs[i % SUM_COUNT] = vec_fmadd_ps(inputsVec, weightVec, sumVecs[i % SUM_COUNT]);
             }
 
-            L3Output = bias + vec_hsum_ps(sumVecs);
+            return bias + vec_hsum_ps(sumVecs);
         }
 
-        return static_cast<i32>(L3Output * OutputScale);
+        inline void ActivateL1Int(const vec_i32* sums, i32 outputBucket, i32* outputs) {
+            const auto biases = reinterpret_cast<const vec_i32*>(&IntLayers.L1Biases[outputBucket][0]);
+
+            const auto zero = vec_set1_epi32(0);
+            const auto one = vec_set1_epi32(L1_INT_ONE);
+            const auto round = vec_set1_epi32(1 << (L1_INT_SHIFT - 1));
+            for (i32 i = 0; i < L2_SIZE / I32_CHUNK_SIZE; i++) {
+                const auto clipped = vec_min_epi32(vec_max_epi32(vec_add_epi32(sums[i], vec_load_epi32(&biases[i])), zero), one);
+
+                //  The clipped values fit in the low 16 bits of each lane, so this squares them.
+                const auto squared = vec_madd_epi16(clipped, clipped);
+                vec_storeu_epi32(reinterpret_cast<vec_i32*>(&outputs[i * I32_CHUNK_SIZE]), vec_srai_epi32(vec_add_epi32(squared, round), L1_INT_SHIFT));
+            }
+        }
+
+        inline void ForwardL2Int(const i32* inputs, i32 outputBucket, i32* outputs) {
+            const auto weights = reinterpret_cast<const vec_i16*>(&IntLayers.L2Weights[outputBucket][0]);
+            const auto biases = reinterpret_cast<const vec_i32*>(&IntLayers.L2Biases[outputBucket][0]);
+
+            vec_i32 sumVecs[L3_SIZE / I32_CHUNK_SIZE];
+
+            for (i32 i = 0; i < L3_SIZE / I32_CHUNK_SIZE; ++i)
+                sumVecs[i] = vec_load_epi32(&biases[i]);
+
+            for (i32 i = 0; i < L2_SIZE / 2; ++i) {
+                const auto inputPair = vec_set1_epi32(inputs[i * 2] | (inputs[i * 2 + 1] << 16));
+                const auto weight = &weights[i * (L3_SIZE / I32_CHUNK_SIZE)];
+                for (i32 j = 0; j < L3_SIZE / I32_CHUNK_SIZE; ++j)
+                    sumVecs[j] = vec_add_epi32(sumVecs[j], vec_madd_epi16(inputPair, vec_load_epi16(&weight[j])));
+            }
+
+            const auto zero = vec_set1_epi32(0);
+            const auto one = vec_set1_epi32(L2_INT_ONE);
+            const auto round = vec_set1_epi32(1 << (L2_INT_SHIFT - 1));
+            for (i32 i = 0; i < L3_SIZE / I32_CHUNK_SIZE; ++i) {
+                const auto clipped = vec_min_epi32(vec_max_epi32(vec_srai_epi32(sumVecs[i], IntLayers.L2SumShift), zero), one);
+                const auto squared = vec_madd_epi16(clipped, clipped);
+                vec_storeu_epi32(reinterpret_cast<vec_i32*>(&outputs[i * I32_CHUNK_SIZE]), vec_srai_epi32(vec_add_epi32(squared, round), L2_INT_SHIFT));
+            }
+        }
+
+        inline i32 ForwardL3Int(const i32* inputs, i32 outputBucket) {
+            const auto weights = reinterpret_cast<const vec_i32*>(&IntLayers.L3Weights[outputBucket][0]);
+
+            auto sumVec = vec_set1_epi32(0);
+            for (i32 i = 0; i < L3_SIZE / I32_CHUNK_SIZE; i++) {
+                const auto inputsVec = vec_load_epi32(reinterpret_cast<const vec_i32*>(&inputs[i * I32_CHUNK_SIZE]));
+                sumVec = vec_add_epi32(sumVec, vec_madd_epi16(inputsVec, vec_load_epi32(&weights[i])));
+            }
+
+            const i64 sum = vec_hsum_epi32(sumVec) + IntLayers.L3Biases[outputBucket];
+            return static_cast<i32>((sum * IntLayers.OutputMul) / (1LL << 32));
+        }
+
+        //  Runs the layers after the FT, with the fixed point path if it is enabled and this is the main network.
+        template <typename Arch>
+        inline i32 ForwardLayers(const LoadedNetwork<Arch>& nn, const i8* ft_outputs, const u16* nnzIndices, i32 nnzCount, i32 outputBucket) {
+            const auto& weights = *nn.Weights;
+
+            vec_i32 sums[Arch::L2_SIZE / I32_CHUNK_SIZE];
+            SumL1(weights, ft_outputs, nnzIndices, nnzCount, outputBucket, sums);
+
+            if constexpr (std::is_same_v<Arch, MainArch>) {
+                if (UseIntLayers) {
+                    alignas(64) i32 L1Outputs[L2_SIZE];
+                    alignas(64) i32 L2Outputs[L3_SIZE];
+
+                    ActivateL1Int(sums, outputBucket, L1Outputs);
+                    ForwardL2Int(L1Outputs, outputBucket, L2Outputs);
+                    return ForwardL3Int(L2Outputs, outputBucket);
+                }
+            }
+
+            alignas(64) float L1Outputs[Arch::L2_SIZE];
+            alignas(64) float L2Outputs[Arch::L3_SIZE];
+
+            ActivateL1(weights, sums, outputBucket, L1Outputs);
+            ForwardL2(weights, L1Outputs, outputBucket, L2Outputs);
+            return static_cast<i32>(ForwardL3(weights, L2Outputs, outputBucket) * OutputScale);
+        }
+
+        constexpr i32 OutputBucket(u64 occupancy) {
+            return (popcount(occupancy) - 2) / ((32 + OUTPUT_BUCKETS - 1) / OUTPUT_BUCKETS);
+        }
+
+        template <typename Arch>
+        inline i32 Evaluate(const LoadedNetwork<Arch>& nn, AccumulatorStack<Arch>& accumulators, Position& pos, i32 outputBucket) {
+            const auto accumulator = accumulators.Head();
+            accumulators.EnsureUpdated(pos);
+
+            const auto us = Span<i16>(accumulator->Sides[pos.ToMove]);
+            const auto them = Span<i16>(accumulator->Sides[Not(pos.ToMove)]);
+
+            alignas(64) i8 ft_outputs[Arch::L1_SIZE];
+
+            u16 nnzIndices[Arch::L1_SIZE / L1_CHUNK_PER_32];
+
+            const i32 nnzCount = ActivateFT(nn, us.data(), them.data(), ft_outputs, nnzIndices);
+            if constexpr (std::is_same_v<Arch, MainArch>) {
+                if (CountingActivations)
+                    CountActivations(ft_outputs, nnzIndices, nnzCount);
+            }
+
+            return ForwardLayers(nn, ft_outputs, nnzIndices, nnzCount, outputBucket);
+        }
+    }
+
+    i32 GetEvaluation(Position& pos) {
+        return GetEvaluation(pos, OutputBucket(pos.bb.Occupancy));
     }
 
+    i32 GetEvaluation(Position& pos, i32 outputBucket) {
+        return Evaluate(MainNet, pos.Accumulators, pos, outputBucket);
+    }
+
+    //  Evaluates with the small network, which has to be loaded, and so pos has its accumulators.
+    i32 GetSmallEvaluation(Position& pos) {
+        return Evaluate(SmallNet, *pos.SmallAccumulators, pos, OutputBucket(pos.bb.Occupancy));
+    }
+
+    //  Evaluates every entry from the point of view of its side to move, without going through an AccumulatorStack.
+    //  Each position's accumulators are built from scratch and activated first, and then the L1-L3 layers are run
+    //  one output bucket at a time, so each bucket's weights stay in cache while all of its positions go through them.
+    void GetEvaluations(std::span<EvalBatchEntry> entries) {
+        constexpr i32 ChunkSize = 256;
+
+        struct alignas(64) Activation {
+            i8 FTOutputs[L1_SIZE];
+            u16 NNZIndices[L1_SIZE / L1_CHUNK_PER_32];
+            i32 NNZCount;
+            i32 Bucket;
+        };
+
+        std::vector<Activation> activations(ChunkSize);
+        alignas(64) std::array<i16, L1_SIZE> sides[2];
+        std::array<std::vector<i32>, OUTPUT_BUCKETS> byBucket{};
 
+        for (size_t base = 0; base < entries.size(); base += ChunkSize) {
+            const auto count = std::min<size_t>(ChunkSize, entries.size() - base);
+
+            for (auto& list : byBucket)
+                list.clear();
+
+            for (size_t n = 0; n < count; n++) {
+                const auto& entry = entries[base + n];
+                const auto& bb = entry.bb;
+
+                for (i32 perspective = 0; perspective < 2; perspective++) {
+                    const i32 ourKing = bb.KingIndex(perspective);
+
+                    i32 adds[32];
+                    i32 addCnt = 0;
+
+                    u64 occ = bb.Occupancy;
+                    while (occ != 0) {
+                        const i32 sq = poplsb(occ);
+                        adds[addCnt++] = FeatureIndexSingle<MainArch>(bb.GetColorAtIndex(sq), bb.GetPieceAtIndex(sq), sq, ourKing, perspective);
+                    }
+
+                    ApplyDeltas(MainNet, &MainNet.Weights->FTBiases[0], &sides[perspective][0], nullptr, adds, addCnt, nullptr, 0);
+                }
+
+                auto& act = activations[n];
+                act.NNZCount = ActivateFT(MainNet, &sides[entry.ToMove][0], &sides[Not(entry.ToMove)][0], act.FTOutputs, act.NNZIndices);
+                act.Bucket = OutputBucket(bb.Occupancy);
+                byBucket[act.Bucket].push_back(static_cast<i32>(n));
+            }
+
+            for (i32 bucket = 0; bucket < OUTPUT_BUCKETS; bucket++) {
+                for (i32 n : byBucket[bucket]) {
+                    const auto& act = activations[n];
+                    entries[base + n].Score = ForwardLayers(MainNet, act.FTOutputs, act.NNZIndices, act.NNZCount, bucket);
+                }
+            }
+        }
+    }
+
+    template <typename Arch>
     std::pair<i32, i32> FeatureIndex(i32 pc, i32 pt, i32 sq, i32 wk, i32 bk) {
         const i32 ColorStride = 64 * 6;
         const i32 PieceStride = 64;
@@ -273,12 +1256,13 @@ namespace Horsie::NNUE {
             bSq ^= 7;
         }
 
-        i32 whiteIndex = (768 * KingBuckets[wk]) + (pc * ColorStride) + (pt * PieceStride) + wSq;
-        i32 blackIndex = (768 * KingBuckets[bk]) + (Not(pc) * ColorStride) + (pt * PieceStride) + bSq;
+        i32 whiteIndex = (768 * Arch::KingBuckets[wk]) + (pc * ColorStride) + (pt * PieceStride) + wSq;
+        i32 blackIndex = (768 * Arch::KingBuckets[bk]) + (Not(pc) * ColorStride) + (pt * PieceStride) + bSq;
 
-        return { whiteIndex * L1_SIZE, blackIndex * L1_SIZE };
+        return { whiteIndex * Arch::L1_SIZE, blackIndex * Arch::L1_SIZE };
     }
 
+    template <typename Arch>
     i32 FeatureIndexSingle(i32 pc, i32 pt, i32 sq, i32 kingSq, i32 perspective) {
         const i32 ColorStride = 64 * 6;
         const i32 PieceStride = 64;
@@ -293,84 +1277,71 @@ namespace Horsie::NNUE {
             kingSq ^= 7;
         }
 
-        return ((768 * KingBuckets[kingSq]) + ((pc ^ perspective) * ColorStride) + (pt * PieceStride) + (sq)) * L1_SIZE;
+        return ((768 * Arch::KingBuckets[kingSq]) + ((pc ^ perspective) * ColorStride) + (pt * PieceStride) + (sq)) * Arch::L1_SIZE;
     }
 
+    template std::pair<i32, i32> FeatureIndex<MainArch>(i32, i32, i32, i32, i32);
+    template std::pair<i32, i32> FeatureIndex<SmallArch>(i32, i32, i32, i32, i32);
+    template i32 FeatureIndexSingle<MainArch>(i32, i32, i32, i32, i32);
+    template i32 FeatureIndexSingle<SmallArch>(i32, i32, i32, i32, i32);
+
 
     void ResetCaches(Position& pos) {
-        for (auto& bucket : pos.CachedBuckets) {
-            bucket.accumulator.Sides[WHITE] = bucket.accumulator.Sides[BLACK] = net.FTBiases;
-            bucket.Boards[WHITE].Reset();
-            bucket.Boards[BLACK].Reset();
-        }
+        pos.Accumulators.ResetCaches();
+        if (pos.SmallAccumulators)
+            pos.SmallAccumulators->ResetCaches();
     }
 
-    //  See https://github.com/Ciekce/Stormphrax/pull/176 for the non-scuffed impl of this.
-    void LoadZSTD(std::istream& m_stream, std::byte* dst) {
-        size_t m_pos = 0;
-        size_t m_end = 0;
-        size_t m_result = 0;
-
-        std::vector<std::byte> m_inBuf(ZSTD_DStreamInSize());
-        std::vector<std::byte> m_outBuf(ZSTD_DStreamOutSize());
-        ZSTD_inBuffer m_input{};
-        ZSTD_outBuffer m_output{};
+    //  Decompresses a network of dstSize bytes straight into dst, reading the stream in ZSTD_DStreamInSize() pieces.
+    //  Returns false if the data is corrupt or ends before all of dst was written.
+    bool LoadZSTD(std::istream& stream, std::byte* dst, nuint dstSize) {
+        std::vector<std::byte> inBuf(ZSTD_DStreamInSize());
+        ZSTD_inBuffer input{ inBuf.data(), 0, 0 };
+        ZSTD_outBuffer output{ dst, dstSize, 0 };
 
-        m_input.src = m_inBuf.data();
-        m_output.dst = m_outBuf.data();
+        auto dStream = ZSTD_createDStream();
+        ZSTD_initDStream(dStream);
 
-        auto m_dStream = ZSTD_createDStream();
+        while (output.pos < output.size) {
+            if (input.pos == input.size) {
+                stream.read(reinterpret_cast<char*>(inBuf.data()), static_cast<std::streamsize>(inBuf.size()));
 
-        size_t n = sizeof(Network);
-        while (n > 0) {
-            while (m_pos >= m_end && (m_input.pos < m_input.size || !m_stream.fail())) {
-
-                if (m_input.pos == m_input.size) {
-                    if (!m_stream) {
-                        break;
-                    }
+                input.size = static_cast<size_t>(stream.gcount());
+                input.pos = 0;
 
-                    m_stream.read(reinterpret_cast<char*>(m_inBuf.data()), static_cast<std::streamsize>(m_inBuf.size()));
-
-                    m_input.size = m_stream.gcount();
-                    m_input.pos = 0;
-                }
-
-                if (m_result == 0 && m_input.pos < m_input.size)
-                    ZSTD_initDStream(m_dStream);
-
-                m_output.size = m_outBuf.size();
-                m_output.pos = 0;
-
-                m_result = ZSTD_decompressStream(m_dStream, &m_output, &m_input);
-
-                if (ZSTD_isError(m_result)) {
-                    const auto code = ZSTD_getErrorCode(m_result);
-                    std::cerr << "zstd error: " << ZSTD_getErrorString(code) << std::endl;
+                if (input.size == 0)
                     break;
-                }
-
-                m_pos = 0;
-                m_end = m_output.pos;
             }
 
-            if (m_pos >= m_end) {
-                ZSTD_freeDStream(m_dStream);
-                return;
+            const auto result = ZSTD_decompressStream(dStream, &output, &input);
+            if (ZSTD_isError(result)) {
+                std::cerr << "zstd error: " << ZSTD_getErrorString(ZSTD_getErrorCode(result)) << std::endl;
+                break;
             }
+        }
 
-            const auto remaining = m_end - m_pos;
-            const auto count = std::min(n, remaining);
+        ZSTD_freeDStream(dStream);
+        return output.pos == dstSize;
+    }
 
-            std::memcpy(dst, &m_outBuf[m_pos], count);
+    //  Same as above, for compressed data that is already in memory.
+    bool LoadZSTD(const std::byte* src, nuint size, std::byte* dst, nuint dstSize) {
+        ZSTD_inBuffer input{ src, size, 0 };
+        ZSTD_outBuffer output{ dst, dstSize, 0 };
 
-            m_pos += count;
-            dst += count;
+        auto dStream = ZSTD_createDStream();
+        ZSTD_initDStream(dStream);
 
-            n -= count;
+        while (output.pos < output.size && input.pos < input.size) {
+            const auto result = ZSTD_decompressStream(dStream, &output, &input);
+            if (ZSTD_isError(result)) {
+                std::cerr << "zstd error: " << ZSTD_getErrorString(ZSTD_getErrorCode(result)) << std::endl;
+                break;
+            }
         }
 
-        ZSTD_freeDStream(m_dStream);
+        ZSTD_freeDStream(dStream);
+        return output.pos == dstSize;
     }
 
     bool IsCompressed(std::istream& stream) {
@@ -381,103 +1352,115 @@ namespace Horsie::NNUE {
         return (headerMaybe == ZSTD_HEADER);
     }
 
-    void PermuteFT(Span<i16> ftWeights, Span<i16> ftBiases) {
-        const i32 OneBucket = (INPUT_SIZE * L1_SIZE);
-        std::vector<i16> temp(OneBucket, 0);
-
-        for (i32 bucket = 0; bucket < INPUT_BUCKETS; bucket++) {
-            Span<i16> ftBucket = Span<i16>(&ftWeights[(bucket * OneBucket)], OneBucket);
-
-            for (size_t i = 0; i < OneBucket; i++)
-                temp[i] = ftBucket[i];
+    bool IsCompressed(const std::byte* data, nuint size) {
+        const i32 ZSTD_HEADER = -47205080;
+        i32 headerMaybe = 0;
+        if (size >= sizeof(headerMaybe))
+            std::memcpy(&headerMaybe, data, sizeof(headerMaybe));
 
-            for (i32 i = 0; i < INPUT_SIZE; i++) {
-                for (i32 dst = 0; dst < L1_PAIR_COUNT; dst++) {
-                    i32 src = PermuteIndices[dst];
-                    auto f = i * L1_SIZE;
+        return (headerMaybe == ZSTD_HEADER);
+    }
 
-                    ftBucket[f + dst] = temp[f + src];
-                    ftBucket[f + dst + L1_PAIR_COUNT] = temp[f + src + L1_PAIR_COUNT];
+    namespace {
+        //  Adds and removes any number of features in one pass. Each tile of ACC_TILE_REGS vectors is loaded from src once,
+        //  has every FT row in adds and subs applied to it in registers, and is stored to dst (and copy, if it isn't null) once.
+        //  The feature offsets are the ones returned by FeatureIndex / FeatureIndexSingle.
+        template <typename W>
+        void ApplyDeltas(const W* FeatureWeights, i32 chunks, const i16* _src, i16* _dst, i16* _copy, const i32* adds, i32 addCnt, const i32* subs, i32 subCnt) {
+            for (i32 tile = 0; tile < chunks; tile += ACC_TILE_REGS) {
+                vec_i16 regs[ACC_TILE_REGS];
+
+                const auto src = reinterpret_cast<const vec_i16*>(_src) + tile;
+                for (i32 k = 0; k < ACC_TILE_REGS; k++)
+                    regs[k] = src[k];
+
+                for (i32 i = 0; i < subCnt; i++) {
+                    const auto weights = &FeatureWeights[subs[i]];
+                    for (i32 k = 0; k < ACC_TILE_REGS; k++)
+                        regs[k] = vec_sub_epi16(regs[k], LoadFTWeights(weights, tile + k));
                 }
-            }
-        }
 
-        std::vector<i16> temp2(L1_SIZE, 0);
-        for (i32 i = 0; i < L1_SIZE; i++)
-            temp2[i] = ftBiases[i];
-
-        for (i32 dst = 0; dst < L1_PAIR_COUNT; dst++) {
-            i32 src = PermuteIndices[dst];
-
-            ftBiases[dst] = temp2[src];
-            ftBiases[dst + L1_PAIR_COUNT] = temp2[src + L1_PAIR_COUNT];
-        }
-    }
-
-    void PermuteL1(i8 l1Weights[L1_SIZE][OUTPUT_BUCKETS][L2_SIZE]) {
-        auto temp = new i8[L1_SIZE][OUTPUT_BUCKETS][L2_SIZE];
-        std::memcpy(temp, l1Weights, N_L1W);
+                for (i32 i = 0; i < addCnt; i++) {
+                    const auto weights = &FeatureWeights[adds[i]];
+                    for (i32 k = 0; k < ACC_TILE_REGS; k++)
+                        regs[k] = vec_add_epi16(regs[k], LoadFTWeights(weights, tile + k));
+                }
 
-        for (i32 dst = 0; dst < L1_PAIR_COUNT; dst++) {
-            i32 src = PermuteIndices[dst];
+                const auto dst = reinterpret_cast<vec_i16*>(_dst) + tile;
+                for (i32 k = 0; k < ACC_TILE_REGS; k++)
+                    dst[k] = regs[k];
 
-            for (i32 b = 0; b < OUTPUT_BUCKETS; b++) {
-                for (i32 l2 = 0; l2 < L2_SIZE; l2++) {
-                    l1Weights[dst][b][l2] = temp[src][b][l2];
-                    l1Weights[dst + L1_PAIR_COUNT][b][l2] = temp[src + L1_PAIR_COUNT][b][l2];
+                if (_copy) {
+                    const auto copy = reinterpret_cast<vec_i16*>(_copy) + tile;
+                    for (i32 k = 0; k < ACC_TILE_REGS; k++)
+                        copy[k] = regs[k];
                 }
             }
         }
+    }
 
-        delete[] temp;
+    template <typename Arch>
+    void ApplyDeltas(const LoadedNetwork<Arch>& nn, const i16* src, i16* dst, i16* copy, const i32* adds, i32 addCnt, const i32* subs, i32 subCnt) {
+        if (nn.FTWeights8)
+            ApplyDeltas(nn.FTWeights8, nn.FTChunks, src, dst, copy, adds, addCnt, subs, subCnt);
+        else
+            ApplyDeltas(&nn.Weights->FTWeights[0], nn.FTChunks, src, dst, copy, adds, addCnt, subs, subCnt);
     }
 
-    void SubSubAddAdd(const i16* _src, i16* _dst, const i16* _sub1, const i16* _sub2, const i16* _add1, const i16* _add2) {
+    template void ApplyDeltas<MainArch>(const LoadedNetwork<MainArch>&, const i16*, i16*, i16*, const i32*, i32, const i32*, i32);
+    template void ApplyDeltas<SmallArch>(const LoadedNetwork<SmallArch>&, const i16*, i16*, i16*, const i32*, i32, const i32*, i32);
+
+    template <typename W>
+    void SubSubAddAdd(i32 chunks, const i16* _src, i16* _dst, const W* sub1, const W* sub2, const W* add1, const W* add2) {
         const vec_i16* src = reinterpret_cast<const vec_i16*>(_src);
         vec_i16* dst = reinterpret_cast<vec_i16*>(_dst);
-        const vec_i16* sub1 = reinterpret_cast<const vec_i16*>(_sub1);
-        const vec_i16* sub2 = reinterpret_cast<const vec_i16*>(_sub2);
-        const vec_i16* add1 = reinterpret_cast<const vec_i16*>(_add1);
-        const vec_i16* add2 = reinterpret_cast<const vec_i16*>(_add2);
-        for (i32 i = 0; i < SIMD_CHUNKS; i++) {
-            dst[i] = vec_sub_epi16(vec_sub_epi16(vec_add_epi16(vec_add_epi16(src[i], add1[i]), add2[i]), sub1[i]), sub2[i]);
+        for (i32 i = 0; i < chunks; i++) {
+            dst[i] = vec_sub_epi16(vec_sub_epi16(vec_add_epi16(vec_add_epi16(src[i], LoadFTWeights(add1, i)), LoadFTWeights(add2, i)), LoadFTWeights(sub1, i)), LoadFTWeights(sub2, i));
         }
     }
 
-    void SubSubAdd(const i16* _src, i16* _dst, const i16* _sub1, const i16* _sub2, const i16* _add1) {
+    template <typename W>
+    void SubSubAdd(i32 chunks, const i16* _src, i16* _dst, const W* sub1, const W* sub2, const W* add1) {
         const vec_i16* src = reinterpret_cast<const vec_i16*>(_src);
         vec_i16* dst = reinterpret_cast<vec_i16*>(_dst);
-        const vec_i16* sub1 = reinterpret_cast<const vec_i16*>(_sub1);
-        const vec_i16* sub2 = reinterpret_cast<const vec_i16*>(_sub2);
-        const vec_i16* add1 = reinterpret_cast<const vec_i16*>(_add1);
-        for (i32 i = 0; i < SIMD_CHUNKS; i++) {
-            dst[i] = vec_sub_epi16(vec_sub_epi16(vec_add_epi16(src[i], add1[i]), sub1[i]), sub2[i]);
+        for (i32 i = 0; i < chunks; i++) {
+            dst[i] = vec_sub_epi16(vec_sub_epi16(vec_add_epi16(src[i], LoadFTWeights(add1, i)), LoadFTWeights(sub1, i)), LoadFTWeights(sub2, i));
         }
     }
 
-    void SubAdd(const i16* _src, i16* _dst, const i16* _sub1, const i16* _add1) {
+    template <typename W>
+    void SubAdd(i32 chunks, const i16* _src, i16* _dst, const W* sub1, const W* add1) {
         const vec_i16* src = reinterpret_cast<const vec_i16*>(_src);
         vec_i16* dst = reinterpret_cast<vec_i16*>(_dst);
-        const vec_i16* sub1 = reinterpret_cast<const vec_i16*>(_sub1);
-        const vec_i16* add1 = reinterpret_cast<const vec_i16*>(_add1);
-        for (i32 i = 0; i < SIMD_CHUNKS; i++) {
-            dst[i] = vec_sub_epi16(vec_add_epi16(src[i], add1[i]), sub1[i]);
+        for (i32 i = 0; i < chunks; i++) {
+            dst[i] = vec_sub_epi16(vec_add_epi16(src[i], LoadFTWeights(add1, i)), LoadFTWeights(sub1, i));
         }
     }
 
-    void Add(const i16* _src, i16* _dst, const i16* _add1) {
+    template <typename W>
+    void Add(i32 chunks, const i16* _src, i16* _dst, const W* add1) {
         const vec_i16* src = reinterpret_cast<const vec_i16*>(_src);
         vec_i16* dst = reinterpret_cast<vec_i16*>(_dst);
-        const vec_i16* add1 = reinterpret_cast<const vec_i16*>(_add1);
-        for (i32 i = 0; i < SIMD_CHUNKS; i++)
-            dst[i] = vec_add_epi16(src[i], add1[i]);
+        for (i32 i = 0; i < chunks; i++)
+            dst[i] = vec_add_epi16(src[i], LoadFTWeights(add1, i));
     }
 
-    void Sub(const i16* _src, i16* _dst, const i16* _sub1) {
+    template <typename W>
+    void Sub(i32 chunks, const i16* _src, i16* _dst, const W* sub1) {
         const vec_i16* src = reinterpret_cast<const vec_i16*>(_src);
         vec_i16* dst = reinterpret_cast<vec_i16*>(_dst);
-        const vec_i16* sub1 = reinterpret_cast<const vec_i16*>(_sub1);
-        for (i32 i = 0; i < SIMD_CHUNKS; i++)
-            dst[i] = vec_sub_epi16(src[i], sub1[i]);
+        for (i32 i = 0; i < chunks; i++)
+            dst[i] = vec_sub_epi16(src[i], LoadFTWeights(sub1, i));
     }
+
+    template void SubSubAddAdd<i16>(i32, const i16*, i16*, const i16*, const i16*, const i16*, const i16*);
+    template void SubSubAddAdd<i8>(i32, const i16*, i16*, const i8*, const i8*, const i8*, const i8*);
+    template void SubSubAdd<i16>(i32, const i16*, i16*, const i16*, const i16*, const i16*);
+    template void SubSubAdd<i8>(i32, const i16*, i16*, const i8*, const i8*, const i8*);
+    template void SubAdd<i16>(i32, const i16*, i16*, const i16*, const i16*);
+    template void SubAdd<i8>(i32, const i16*, i16*, const i8*, const i8*);
+    template void Add<i16>(i32, const i16*, i16*, const i16*);
+    template void Add<i8>(i32, const i16*, i16*, const i8*);
+    template void Sub<i16>(i32, const i16*, i16*, const i16*);
+    template void Sub<i8>(i32, const i16*, i16*, const i8*);
 }
@@ -1,71 +1,160 @@
 #pragma once
 
-#define PERM_COUNT 1
-#undef PERM_COUNT
-
 #define NO_WEIGHT_PERMUTING 1
 #undef NO_WEIGHT_PERMUTING
 
+#define NO_FT_PRUNING 1
+#undef NO_FT_PRUNING
+
+#define NO_I8_FT_WEIGHTS 1
+#undef NO_I8_FT_WEIGHTS
+
 #include "../defs.h"
 #include "../nnue/arch.h"
 #include "../position.h"
 #include "accumulator.h"
 
 #include <array>
+#include <cstddef>
 #include <span>
 
 namespace Horsie::NNUE {
 
-#if defined(PERM_COUNT)
-    extern std::array<u64, L1_SIZE> NNZCounts;
-    extern u64 ActivationCount;
-    extern u64 EvalCalls;
-#endif
-
     template<typename T>
     using Span = std::span<T>;
 
-    template <typename T, typename W, typename U>
+    template <typename Arch, typename T = i16, typename W = i8, typename U = float>
     struct alignas(64) NetworkBase {
-        std::array<T, INPUT_SIZE * L1_SIZE * INPUT_BUCKETS> FTWeights;
-        std::array<T, L1_SIZE>                              FTBiases;
-        Util::NDArray<W, OUTPUT_BUCKETS, L1_SIZE * L2_SIZE> L1Weights;
-        Util::NDArray<U, OUTPUT_BUCKETS, L2_SIZE>           L1Biases;
-        Util::NDArray<U, OUTPUT_BUCKETS, L2_SIZE * L3_SIZE> L2Weights;
-        Util::NDArray<U, OUTPUT_BUCKETS, L3_SIZE>           L2Biases;
-        Util::NDArray<U, OUTPUT_BUCKETS, L3_SIZE>           L3Weights;
-        std::array<U, OUTPUT_BUCKETS>                       L3Biases;
+        std::array<T, Arch::N_FTW>                                      FTWeights;
+        std::array<T, Arch::L1_SIZE>                                    FTBiases;
+        Util::NDArray<W, OUTPUT_BUCKETS, Arch::L1_SIZE * Arch::L2_SIZE> L1Weights;
+        Util::NDArray<U, OUTPUT_BUCKETS, Arch::L2_SIZE>                 L1Biases;
+        Util::NDArray<U, OUTPUT_BUCKETS, Arch::L2_SIZE * Arch::L3_SIZE> L2Weights;
+        Util::NDArray<U, OUTPUT_BUCKETS, Arch::L3_SIZE>                 L2Biases;
+        Util::NDArray<U, OUTPUT_BUCKETS, Arch::L3_SIZE>                 L3Weights;
+        std::array<U, OUTPUT_BUCKETS>                                   L3Biases;
+    };
+    using Network = NetworkBase<MainArch>;
+    using SmallNetwork = NetworkBase<SmallArch>;
+
+    //  Header of the files written by exportnet, which is padded to a page so that the weights after it can be mapped in place.
+    struct NetworkBlobHeader {
+        u64 Magic;
+        u32 Version;
+        /// How many neuron pairs the FT was pruned to, see PruneFT
+        u32 FTPairs;
+        u64 NetworkSize;
+        /// The SIMD target whose FT layout the weights are in, see InterleaveFT
+        char Target[16];
+        /// 1 if the FT weights are stored as i8 in the first half of FTWeights (see CompactFT), or 2 if they are i16
+        u32 FTWeightBytes;
+        u32 Reserved;
+        /// The original index of each neuron pair, see PermuteNetwork
+        u16 Order[L1_PAIR_COUNT];
+        std::byte Padding[4096 - 48 - sizeof(u16) * L1_PAIR_COUNT];
+    };
+
+    static_assert(sizeof(NetworkBlobHeader) == 4096, "Unexpected NetworkBlobHeader size");
+
+    constexpr u64 NetworkBlobMagic = 0x54454E45'53524F48;  //  "HORSENET"
+    constexpr u32 NetworkBlobVersion = 4;
+
+#if defined(AVX512)
+#define SIMD_TARGET_NAME "avx512"
+#elif defined(AVX256)
+#define SIMD_TARGET_NAME "avx2"
+#else
+#define SIMD_TARGET_NAME "128-bit"
+#endif
+
+    constexpr const char* SIMDTarget = SIMD_TARGET_NAME;
+
+    //  The kernels that this build uses, which "uci" reports since a fat binary only chooses them at startup.
+    constexpr const char* BuildTarget = SIMD_TARGET_NAME
+#if defined(USE_VNNI)
+        " vnni"
+#endif
+#if defined(USE_PEXT)
+        " pext"
+#endif
+#if defined(FAT_BINARY)
+        " (fat binary)"
+#endif
+        ;
+
+#undef SIMD_TARGET_NAME
+
+    //  A network that can be evaluated with, which is either owned by nn.cpp or mapped from an EvalFile.
+    //  FTPairs is how many of its FT's neuron pairs were kept after the dead ones were pruned, and FTChunks is how many
+    //  vectors their two halves take up. Only the first FTChunks vectors of an accumulator are ever updated or read.
+    //  If every FT weight fits in an i8, FTWeights8 points at an i8 copy of them in the first half of Weights->FTWeights,
+    //  which is what the accumulators are updated with instead. They are sign extended and still accumulated as i16.
+    template <typename Arch>
+    struct LoadedNetwork {
+        NetworkBase<Arch>* Weights = nullptr;
+        const i8* FTWeights8 = nullptr;
+        i32 FTPairs = Arch::L1_PAIR_COUNT;
+        i32 FTChunks = Arch::SIMD_CHUNKS;
     };
-    using Network = NetworkBase<i16, i8, float>;
 
-    extern Network net;
+    //  MainNet is used everywhere, and SmallNet is an optional second network with a much narrower FT
+    //  that search can use for cheaper evaluations. Only the main network is ever pruned, permuted or exported.
+    extern LoadedNetwork<MainArch> MainNet;
+    extern LoadedNetwork<SmallArch> SmallNet;
 
     bool IsCompressed(std::istream& stream);
-    void LoadZSTD(std::istream& m_stream, std::byte* dst);
-    void LoadNetwork(const std::string& name);
-    void PermuteFT(Span<i16> ftWeights, Span<i16> ftBiases);
-    void PermuteL1(i8 l1Weights[L1_SIZE][OUTPUT_BUCKETS][L2_SIZE]);
+    bool IsCompressed(const std::byte* data, nuint size);
+    bool LoadZSTD(std::istream& stream, std::byte* dst, nuint dstSize);
+    bool LoadZSTD(const std::byte* src, nuint size, std::byte* dst, nuint dstSize);
+    bool LoadNetwork(const std::string& name);
+    bool LoadNetworkFile(const std::string& path);
+    bool ExportNetwork(const std::string& path);
+    const std::string& NetworkName();
+    bool IsNetworkMapped();
+
+    //  Loads the network in the file at path as the small network, or unloads it if path is empty.
+    //  The file is a SmallNetwork in the same format as the embedded network, and may be compressed.
+    bool LoadSmallNetworkFile(const std::string& path);
+    bool HasSmallNetwork();
+
+    //  Switches between the float and fixed point versions of the layers after the FT.
+    //  Returns whether the fixed point layers are in use, which they can't be if the network's weights don't fit them.
+    bool SetIntegerLayers(bool enabled);
+    template <typename Arch> void InterleaveFT(NetworkBase<Arch>& nn);
+
+    //  The order of the FT's neuron pairs, where Permutation[i] is the index that the pair at i had in the original network.
+    //  Sorting the pairs that are most often nonzero to the front makes the NNZ chunks that L1 reads denser.
+    using Permutation = std::array<i32, L1_PAIR_COUNT>;
+
+    bool IsPermutation(const Permutation& perm);
+    bool ReadPermutation(const std::string& path, Permutation& perm);
+    bool WritePermutation(const std::string& path, const Permutation& perm);
+    bool ApplyPermutation(const Permutation& perm);
+
+    //  Counts how often each neuron pair is nonzero in GetEvaluation until FinishActivationCount, which returns the order
+    //  of the original network's pairs from most to least active. evals and averageChunks are set to the number of
+    //  evaluations counted and the average number of nonzero 4 byte chunks that L1 read in them.
+    void StartActivationCount();
+    Permutation FinishActivationCount(u64& evals, double& averageChunks);
 
     i32 GetEvaluation(Position& pos, i32 outputBucket);
     i32 GetEvaluation(Position& pos);
+    i32 GetSmallEvaluation(Position& pos);
 
-    std::pair<i32, i32> FeatureIndex(i32 pc, i32 pt, i32 sq, i32 wk, i32 bk);
-    i32 FeatureIndexSingle(i32 pc, i32 pt, i32 sq, i32 kingSq, i32 perspective);
+    struct EvalBatchEntry {
+        Bitboard bb;
+        i32 ToMove;
+        i32 Score;
+    };
 
+    void GetEvaluations(std::span<EvalBatchEntry> entries);
 
-    constexpr i32 KingBuckets[] = {
-         0,  1,  2,  3, 17, 16, 15, 14,
-         4,  5,  6,  7, 21, 20, 19, 18,
-         8,  9, 10, 11, 25, 24, 23, 22,
-         8,  9, 10, 11, 25, 24, 23, 22,
-        12, 12, 13, 13, 27, 27, 26, 26,
-        12, 12, 13, 13, 27, 27, 26, 26,
-        12, 12, 13, 13, 27, 27, 26, 26,
-        12, 12, 13, 13, 27, 27, 26, 26,
-    };
+    template <typename Arch> std::pair<i32, i32> FeatureIndex(i32 pc, i32 pt, i32 sq, i32 wk, i32 bk);
+    template <typename Arch> i32 FeatureIndexSingle(i32 pc, i32 pt, i32 sq, i32 kingSq, i32 perspective);
 
+    template <typename Arch>
     constexpr i32 BucketForPerspective(i32 ksq, i32 perspective) {
-        return (KingBuckets[(ksq ^ (56 * perspective))]);
+        return (Arch::KingBuckets[(ksq ^ (56 * perspective))]);
     }
 
 
@@ -78,78 +167,86 @@ namespace Horsie::NNUE {
 
     void ResetCaches(Position& pos);
 
-    void Sub(const i16* src, i16* dst, const i16* sub1);
-    void Add(const i16* src, i16* dst, const i16* add1);
-    void SubAdd(const i16* src, i16* dst, const i16* sub1, const i16* add1);
-    void SubSubAdd(const i16* src, i16* dst, const i16* sub1, const i16* sub2, const i16* add1);
-    void SubSubAddAdd(const i16* src, i16* dst, const i16* sub1, const i16* sub2, const i16* add1, const i16* add2);
+    //  Loads the i'th vector of an FT row, which is sign extended if the network's FT weights are i8.
+    inline vec_i16 LoadFTWeights(const i16* row, i32 i) { return vec_load_epi16(reinterpret_cast<const vec_i16*>(row) + i); }
+    inline vec_i16 LoadFTWeights(const i8* row, i32 i) { return vec_load_cvtepi8_epi16(row + i * I16_CHUNK_SIZE); }
+
+    //  These update the first chunks vectors of an accumulator, which is a network's FTChunks.
+    //  W is the type of the FT rows, which are i8 if the network has FTWeights8.
+    template <typename W> void Sub(i32 chunks, const i16* src, i16* dst, const W* sub1);
+    template <typename W> void Add(i32 chunks, const i16* src, i16* dst, const W* add1);
+    template <typename W> void SubAdd(i32 chunks, const i16* src, i16* dst, const W* sub1, const W* add1);
+    template <typename W> void SubSubAdd(i32 chunks, const i16* src, i16* dst, const W* sub1, const W* sub2, const W* add1);
+    template <typename W> void SubSubAddAdd(i32 chunks, const i16* src, i16* dst, const W* sub1, const W* sub2, const W* add1, const W* add2);
+    template <typename Arch>
+    void ApplyDeltas(const LoadedNetwork<Arch>& nn, const i16* src, i16* dst, i16* copy, const i32* adds, i32 addCnt, const i32* subs, i32 subCnt);
 
 
     constexpr i32 BestPermuteIndices[] = {
-        238, 406, 493, 921, 296, 700, 1003, 855, 663, 450, 996, 511, 337, 400, 82, 424,
-        841, 984, 769, 554, 653, 181, 678, 286, 266, 667, 109, 604, 78, 303, 713, 798,
-        213, 889, 644, 79, 685, 507, 850, 838, 999, 909, 184, 503, 591, 557, 770, 501,
-        620, 260, 654, 779, 97, 595, 420, 724, 514, 944, 263, 868, 297, 500, 316, 359,
-        797, 879, 386, 9, 699, 453, 570, 73, 568, 69, 596, 194, 198, 330, 916, 807,
-        126, 910, 1007, 475, 494, 734, 427, 414, 936, 822, 542, 81, 349, 197, 71, 818,
-        360, 170, 4, 437, 703, 193, 645, 125, 447, 312, 95, 588, 10, 264, 27, 505,
-        433, 982, 116, 233, 72, 992, 504, 270, 241, 827, 436, 458, 358, 550, 561, 832,
-        275, 295, 1023, 342, 611, 183, 928, 851, 751, 899, 247, 549, 446, 753, 771, 167,
-        612, 963, 136, 849, 635, 328, 134, 617, 768, 621, 431, 735, 294, 422, 639, 958,
-        355, 980, 630, 1020, 661, 392, 357, 174, 391, 931, 664, 372, 469, 1, 171, 623,
-        428, 633, 553, 787, 237, 60, 572, 569, 796, 208, 593, 122, 540, 745, 92, 94,
-        421, 236, 551, 8, 301, 246, 643, 29, 884, 668, 544, 726, 576, 837, 728, 464,
-        288, 259, 249, 811, 867, 350, 13, 468, 616, 763, 520, 628, 302, 196, 16, 0,
-        175, 325, 466, 809, 215, 859, 142, 656, 58, 209, 960, 473, 410, 179, 30, 893,
-        488, 815, 340, 416, 875, 525, 904, 387, 823, 1006, 96, 23, 439, 31, 606, 895,
-        38, 702, 245, 813, 537, 597, 388, 979, 229, 881, 347, 188, 590, 587, 836, 380,
-        506, 204, 335, 327, 619, 1001, 252, 605, 988, 897, 412, 489, 106, 418, 324, 154,
-        17, 498, 32, 714, 833, 528, 636, 367, 15, 51, 14, 45, 160, 332, 935, 559,
-        20, 711, 648, 968, 477, 541, 321, 556, 518, 448, 57, 555, 434, 202, 19, 934,
-        749, 120, 788, 222, 579, 480, 933, 84, 223, 258, 946, 274, 649, 182, 62, 290,
-        729, 894, 153, 101, 989, 853, 864, 137, 976, 954, 940, 821, 124, 415, 522, 66,
-        780, 394, 858, 331, 322, 707, 826, 180, 508, 805, 825, 115, 696, 339, 584, 977,
-        562, 792, 647, 677, 1008, 756, 578, 12, 269, 941, 983, 778, 516, 143, 43, 907,
-        425, 846, 471, 665, 117, 63, 478, 28, 722, 900, 786, 277, 882, 144, 842, 284,
-        21, 594, 905, 190, 232, 772, 262, 465, 659, 351, 938, 444, 834, 795, 219, 496,
-        227, 794, 48, 426, 162, 548, 242, 145, 451, 155, 354, 955, 251, 698, 381, 538,
-        64, 86, 248, 640, 470, 845, 804, 691, 374, 404, 876, 280, 912, 147, 641, 903,
-        211, 1000, 913, 739, 34, 283, 1011, 123, 957, 1010, 341, 87, 375, 371, 948, 377,
-        1015, 441, 326, 552, 627, 607, 586, 800, 923, 345, 759, 111, 732, 276, 363, 467,
-        692, 1021, 362, 364, 300, 24, 91, 440, 212, 560, 885, 113, 129, 871, 886, 88,
-        35, 228, 766, 927, 1009, 527, 799, 687, 378, 793, 975, 987, 271, 950, 765, 138,
-        775, 463, 592, 706, 1013, 483, 178, 748, 539, 566, 133, 361, 998, 99, 738, 376,
-        721, 599, 961, 883, 243, 932, 26, 41, 1014, 291, 495, 93, 310, 365, 760, 482,
-        783, 589, 42, 172, 1017, 828, 773, 166, 803, 959, 148, 812, 230, 672, 622, 1005,
-        930, 781, 334, 531, 383, 750, 671, 411, 573, 727, 571, 613, 774, 176, 785, 547,
-        937, 390, 725, 158, 880, 887, 187, 972, 385, 314, 59, 533, 157, 860, 65, 261,
-        642, 318, 695, 764, 1004, 658, 974, 389, 717, 396, 85, 472, 486, 461, 449, 265,
-        121, 861, 319, 313, 502, 943, 407, 716, 994, 490, 839, 462, 455, 565, 743, 151,
-        929, 862, 484, 986, 107, 683, 281, 681, 37, 693, 53, 676, 323, 789, 874, 46,
-        603, 863, 510, 949, 366, 289, 235, 491, 408, 819, 852, 962, 405, 546, 816, 723,
-        758, 848, 535, 720, 790, 108, 40, 401, 817, 524, 513, 791, 285, 981, 189, 200,
-        487, 682, 1022, 499, 307, 744, 103, 762, 625, 517, 847, 119, 156, 1018, 767, 255,
-        304, 104, 3, 459, 877, 292, 161, 709, 519, 890, 997, 1019, 128, 873, 239, 680,
-        747, 413, 481, 305, 399, 856, 914, 951, 397, 149, 492, 49, 869, 964, 336, 990,
-        741, 608, 100, 150, 824, 1012, 670, 368, 947, 140, 240, 718, 409, 127, 840, 430,
-        343, 908, 139, 89, 173, 317, 135, 598, 67, 70, 534, 130, 11, 708, 114, 293,
-        704, 56, 705, 74, 892, 452, 536, 402, 694, 131, 808, 956, 370, 68, 257, 191,
-        479, 684, 610, 829, 432, 601, 993, 250, 679, 309, 192, 512, 754, 971, 857, 742,
-        564, 55, 878, 1016, 906, 5, 7, 782, 98, 650, 267, 712, 740, 50, 1002, 141,
-        655, 186, 164, 673, 736, 2, 382, 801, 344, 697, 872, 820, 206, 563, 195, 830,
-        776, 395, 843, 308, 44, 710, 615, 419, 320, 945, 457, 583, 854, 61, 90, 626,
-        199, 529, 523, 132, 201, 614, 76, 268, 47, 634, 582, 279, 970, 152, 254, 731,
-        675, 969, 217, 618, 398, 22, 311, 515, 526, 926, 602, 225, 185, 666, 844, 746,
-        315, 637, 902, 646, 600, 918, 965, 953, 733, 384, 662, 393, 761, 352, 686, 474,
-        752, 530, 165, 220, 558, 224, 715, 985, 922, 253, 629, 379, 810, 737, 203, 346,
-        973, 609, 105, 925, 306, 216, 445, 898, 911, 244, 967, 891, 177, 163, 356, 580,
-        901, 831, 102, 581, 6, 896, 33, 835, 460, 39, 25, 435, 36, 77, 52, 205,
-        110, 521, 757, 802, 168, 915, 688, 118, 210, 755, 545, 329, 282, 214, 784, 333,
-        632, 660, 80, 256, 777, 652, 942, 443, 567, 83, 624, 54, 75, 651, 509, 730,
-        669, 417, 169, 952, 438, 442, 476, 991, 369, 456, 429, 146, 719, 348, 966, 273,
-        978, 353, 221, 888, 575, 454, 159, 631, 870, 689, 920, 234, 287, 543, 532, 814,
-        577, 574, 338, 806, 299, 231, 585, 112, 373, 701, 218, 272, 919, 638, 485, 657,
-        207, 690, 403, 917, 866, 939, 278, 423, 674, 497, 298, 226, 18, 865, 995, 924,
+        508, 71, 12, 726, 96, 370, 590, 969, 369, 294, 221, 133, 460, 857, 731, 636,
+        49, 494, 786, 785, 278, 201, 841, 774, 239, 813, 206, 901, 298, 695, 220, 610,
+        190, 929, 116, 109, 604, 486, 847, 572, 579, 131, 507, 815, 481, 105, 348, 341,
+        971, 409, 767, 812, 926, 655, 529, 541, 215, 944, 34, 563, 165, 965, 290, 305,
+        779, 797, 714, 335, 631, 660, 395, 827, 493, 3, 244, 179, 788, 204, 725, 329,
+        401, 479, 440, 776, 126, 743, 876, 63, 1014, 739, 219, 312, 950, 203, 160, 866,
+        960, 213, 270, 1018, 154, 858, 954, 720, 765, 874, 471, 912, 762, 630, 351, 551,
+        322, 377, 770, 540, 114, 264, 396, 79, 837, 426, 50, 936, 538, 1012, 435, 325,
+        18, 615, 940, 570, 436, 597, 723, 346, 80, 464, 621, 909, 23, 884, 119, 383,
+        76, 656, 412, 694, 302, 553, 732, 394, 968, 921, 945, 742, 750, 247, 385, 1022,
+        134, 441, 237, 56, 110, 995, 525, 777, 503, 560, 583, 564, 456, 772, 24, 561,
+        70, 1008, 589, 289, 106, 99, 132, 520, 212, 404, 1010, 142, 659, 482, 413, 517,
+        367, 629, 439, 642, 429, 618, 469, 829, 822, 492, 870, 180, 796, 345, 337, 13,
+        594, 789, 382, 398, 794, 917, 745, 830, 248, 1005, 171, 336, 612, 782, 193, 418,
+        787, 30, 506, 473, 860, 644, 543, 100, 90, 816, 654, 236, 107, 703, 637, 349,
+        75, 275, 280, 54, 41, 197, 339, 548, 957, 733, 365, 127, 925, 35, 836, 558,
+        235, 933, 526, 246, 363, 490, 97, 645, 416, 766, 17, 438, 626, 532, 900, 94,
+        192, 274, 717, 938, 586, 36, 640, 217, 498, 172, 764, 845, 175, 466, 93, 9,
+        256, 904, 69, 417, 403, 875, 7, 701, 976, 103, 170, 690, 861, 1006, 120, 476,
+        31, 550, 318, 856, 817, 228, 159, 588, 721, 292, 208, 454, 311, 381, 85, 947,
+        1000, 990, 511, 10, 62, 393, 92, 150, 117, 1015, 880, 402, 437, 299, 888, 157,
+        267, 625, 887, 894, 939, 522, 211, 949, 130, 996, 670, 641, 603, 1011, 897, 574,
+        359, 892, 234, 963, 983, 64, 973, 802, 46, 188, 761, 592, 73, 584, 181, 907,
+        303, 491, 877, 263, 675, 176, 128, 959, 859, 310, 755, 209, 650, 677, 277, 620,
+        98, 566, 635, 241, 943, 593, 68, 814, 922, 307, 89, 485, 135, 368, 899, 122,
+        515, 111, 400, 704, 966, 314, 505, 58, 332, 606, 16, 82, 580, 225, 379, 806,
+        685, 233, 389, 826, 29, 913, 284, 19, 265, 214, 885, 410, 890, 916, 1016, 728,
+        729, 534, 783, 978, 288, 5, 86, 998, 162, 163, 183, 300, 942, 104, 146, 387,
+        1017, 1021, 60, 910, 855, 980, 320, 977, 547, 205, 633, 178, 768, 934, 758, 749,
+        240, 895, 463, 946, 994, 91, 705, 689, 251, 790, 44, 384, 838, 821, 330, 923,
+        186, 1004, 155, 696, 582, 820, 937, 449, 872, 376, 601, 986, 722, 840, 226, 693,
+        886, 306, 536, 22, 380, 331, 730, 195, 535, 287, 718, 375, 833, 202, 55, 545,
+        773, 504, 879, 52, 751, 746, 313, 495, 0, 664, 832, 873, 595, 144, 999, 343,
+        707, 227, 953, 803, 255, 151, 970, 903, 14, 984, 281, 317, 713, 634, 961, 374,
+        741, 1002, 974, 573, 468, 315, 419, 697, 484, 222, 40, 531, 614, 43, 279, 769,
+        930, 488, 678, 326, 475, 478, 865, 546, 702, 519, 198, 727, 276, 818, 356, 608,
+        196, 997, 301, 565, 260, 987, 189, 444, 805, 791, 364, 467, 600, 20, 700, 448,
+        411, 487, 682, 161, 39, 514, 145, 77, 824, 736, 269, 598, 617, 623, 809, 587,
+        928, 358, 835, 95, 66, 863, 669, 386, 712, 352, 867, 927, 911, 338, 811, 465,
+        340, 414, 896, 167, 405, 45, 557, 935, 524, 216, 333, 849, 391, 499, 242, 173,
+        139, 825, 350, 962, 523, 932, 1019, 472, 854, 388, 147, 27, 319, 366, 663, 286,
+        881, 893, 862, 792, 138, 869, 425, 737, 864, 527, 652, 497, 780, 149, 512, 985,
+        283, 88, 166, 967, 740, 452, 362, 38, 555, 528, 801, 676, 624, 344, 112, 424,
+        124, 681, 819, 442, 118, 250, 754, 243, 296, 753, 51, 129, 453, 607, 843, 174,
+        605, 207, 613, 321, 738, 32, 902, 993, 223, 982, 952, 357, 905, 125, 518, 1001,
+        101, 569, 919, 510, 334, 257, 21, 834, 169, 643, 853, 658, 354, 304, 699, 191,
+        328, 632, 661, 530, 964, 651, 918, 562, 397, 748, 28, 671, 232, 798, 293, 883,
+        355, 599, 372, 846, 11, 668, 480, 808, 143, 639, 680, 423, 258, 83, 433, 568,
+        47, 516, 672, 552, 61, 8, 1023, 252, 577, 474, 153, 271, 262, 848, 710, 799,
+        229, 823, 941, 253, 102, 567, 521, 831, 477, 259, 602, 6, 272, 581, 948, 688,
+        462, 254, 691, 956, 42, 148, 461, 981, 187, 706, 665, 137, 295, 576, 1009, 653,
+        194, 1, 136, 1007, 185, 152, 1020, 489, 667, 200, 502, 747, 4, 686, 711, 445,
+        177, 578, 261, 575, 744, 549, 795, 920, 539, 420, 427, 407, 989, 361, 627, 509,
+        496, 434, 123, 958, 432, 931, 871, 446, 649, 156, 483, 33, 992, 406, 775, 230,
+        908, 683, 26, 807, 951, 1013, 666, 390, 810, 914, 323, 443, 458, 778, 868, 266,
+        609, 784, 763, 771, 692, 648, 53, 67, 210, 59, 781, 224, 596, 324, 1003, 850,
+        719, 72, 141, 757, 793, 804, 37, 168, 48, 78, 662, 647, 57, 392, 268, 991,
+        622, 455, 619, 734, 679, 421, 447, 611, 353, 972, 955, 924, 327, 360, 140, 752,
+        121, 108, 559, 556, 297, 249, 342, 800, 537, 84, 415, 199, 716, 182, 74, 158,
+        431, 878, 428, 457, 724, 291, 882, 585, 842, 852, 759, 542, 915, 164, 898, 450,
+        422, 500, 373, 616, 735, 628, 646, 308, 698, 979, 430, 87, 15, 459, 501, 533,
+        513, 988, 756, 309, 657, 285, 65, 115, 687, 25, 891, 378, 906, 591, 451, 273,
+        673, 316, 844, 975, 282, 2, 218, 544, 399, 238, 889, 674, 571, 554, 408, 684,
+        245, 715, 113, 760, 828, 231, 839, 347, 470, 371, 851, 638, 184, 709, 708, 81,
     };
 
     constexpr auto PermuteIndices = [] {
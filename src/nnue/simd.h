@@ -46,11 +46,19 @@ namespace Horsie::NNUE {
     inline vec_i16 vec_min_epi16(const vec_i16 a, const vec_i16 b) { return _mm512_min_epi16(a, b); }
     inline vec_i16 vec_max_epi16(const vec_i16 a, const vec_i16 b) { return _mm512_max_epi16(a, b); }
     inline vec_i16 vec_load_epi16(const vec_i16* a) { return _mm512_load_si512(a); }
+    inline vec_i16 vec_load_cvtepi8_epi16(const i8* a) { return _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a))); }
     inline void vec_storeu_i16(vec_i16* a, const vec_i16 b) { _mm512_storeu_si512(a, b); }
 
     inline vec_i32 vec_set1_epi32(const i32 a) { return _mm512_set1_epi32(a); }
     inline vec_i32 vec_add_epi32(const vec_i32 a, const vec_i32 b) { return _mm512_add_epi32(a, b); }
     inline vec_i32 vec_madd_epi16(const vec_i16 a, const vec_i16 b) { return _mm512_madd_epi16(a, b); }
+    inline vec_i32 vec_srai_epi32(const vec_i32 a, const i32 i) { return _mm512_srai_epi32(a, i); }
+    inline vec_i32 vec_min_epi32(const vec_i32 a, const vec_i32 b) { return _mm512_min_epi32(a, b); }
+    inline vec_i32 vec_max_epi32(const vec_i32 a, const vec_i32 b) { return _mm512_max_epi32(a, b); }
+    inline vec_i32 vec_load_epi32(const vec_i32* a) { return _mm512_load_si512(a); }
+    inline void vec_storeu_epi32(vec_i32* a, const vec_i32 b) { _mm512_storeu_si512(a, b); }
+
+    inline i32 vec_hsum_epi32(const vec_i32 v) { return _mm512_reduce_add_epi32(v); }
 
     inline uint16_t vec_nnz_mask(const vec_i32 vec) { return _mm512_cmpgt_epi32_mask(vec, _mm512_setzero_si512()); }
 
@@ -87,11 +95,25 @@ namespace Horsie::NNUE {
     inline vec_i16 vec_min_epi16(const vec_i16 a, const vec_i16 b) { return _mm256_min_epi16(a, b); }
     inline vec_i16 vec_max_epi16(const vec_i16 a, const vec_i16 b) { return _mm256_max_epi16(a, b); }
     inline vec_i16 vec_load_epi16(const vec_i16* a) { return _mm256_load_si256(a); }
+    inline vec_i16 vec_load_cvtepi8_epi16(const i8* a) { return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a))); }
     inline void vec_storeu_i16(vec_i16* a, const vec_i16 b) { _mm256_storeu_si256(a, b); }
 
     inline vec_i32 vec_set1_epi32(const i32 a) { return _mm256_set1_epi32(a); }
     inline vec_i32 vec_add_epi32(const vec_i32 a, const vec_i32 b) { return _mm256_add_epi32(a, b); }
     inline vec_i32 vec_madd_epi16(const vec_i16 a, const vec_i16 b) { return _mm256_madd_epi16(a, b); }
+    inline vec_i32 vec_srai_epi32(const vec_i32 a, const i32 i) { return _mm256_srai_epi32(a, i); }
+    inline vec_i32 vec_min_epi32(const vec_i32 a, const vec_i32 b) { return _mm256_min_epi32(a, b); }
+    inline vec_i32 vec_max_epi32(const vec_i32 a, const vec_i32 b) { return _mm256_max_epi32(a, b); }
+    inline vec_i32 vec_load_epi32(const vec_i32* a) { return _mm256_load_si256(a); }
+    inline void vec_storeu_epi32(vec_i32* a, const vec_i32 b) { _mm256_storeu_si256(a, b); }
+
+    inline i32 vec_hsum_epi32(const vec_i32 v) {
+        const auto sum_128 = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        const auto sum_64 = _mm_add_epi32(sum_128, _mm_shuffle_epi32(sum_128, _MM_SHUFFLE(1, 0, 3, 2)));
+        const auto sum_32 = _mm_add_epi32(sum_64, _mm_shuffle_epi32(sum_64, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        return _mm_cvtsi128_si32(sum_32);
+    }
 
     inline uint16_t vec_nnz_mask(const vec_i32 vec) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(vec, _mm256_setzero_si256()))); }
 
@@ -115,7 +137,14 @@ namespace Horsie::NNUE {
     inline void vec_storeu_epi8(vec_i8* a, const vec_i8 b) { _mm_storeu_si128(a, b); }
 
     inline vec_ps vec_set1_ps(const float a) { return _mm_set1_ps(a); }
-    inline vec_ps vec_fmadd_ps(const vec_ps a, const vec_ps b, const vec_ps c) { return _mm_fmadd_ps(a, b, c); }
+    inline vec_ps vec_fmadd_ps(const vec_ps a, const vec_ps b, const vec_ps c) {
+        //  x86-64-v2 doesn't have FMA
+#if defined(__FMA__) || defined(__AVX2__)
+        return _mm_fmadd_ps(a, b, c);
+#else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+    }
     inline vec_ps vec_min_ps(const vec_ps a, const vec_ps b) { return _mm_min_ps(a, b); }
     inline vec_ps vec_max_ps(const vec_ps a, const vec_ps b) { return _mm_max_ps(a, b); }
     inline vec_ps vec_mul_ps(const vec_ps a, const vec_ps b) { return _mm_mul_ps(a, b); }
@@ -133,11 +162,24 @@ namespace Horsie::NNUE {
     inline vec_i16 vec_min_epi16(const vec_i16 a, const vec_i16 b) { return _mm_min_epi16(a, b); }
     inline vec_i16 vec_max_epi16(const vec_i16 a, const vec_i16 b) { return _mm_max_epi16(a, b); }
     inline vec_i16 vec_load_epi16(const vec_i16* a) { return _mm_load_si128(a); }
+    inline vec_i16 vec_load_cvtepi8_epi16(const i8* a) { return _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a))); }
     inline void vec_storeu_i16(vec_i16* a, const vec_i16 b) { _mm_storeu_si128(a, b); }
 
     inline vec_i32 vec_set1_epi32(const i32 a) { return _mm_set1_epi32(a); }
     inline vec_i32 vec_add_epi32(const vec_i32 a, const vec_i32 b) { return _mm_add_epi32(a, b); }
     inline vec_i32 vec_madd_epi16(const vec_i16 a, const vec_i16 b) { return _mm_madd_epi16(a, b); }
+    inline vec_i32 vec_srai_epi32(const vec_i32 a, const i32 i) { return _mm_srai_epi32(a, i); }
+    inline vec_i32 vec_min_epi32(const vec_i32 a, const vec_i32 b) { return _mm_min_epi32(a, b); }
+    inline vec_i32 vec_max_epi32(const vec_i32 a, const vec_i32 b) { return _mm_max_epi32(a, b); }
+    inline vec_i32 vec_load_epi32(const vec_i32* a) { return _mm_load_si128(a); }
+    inline void vec_storeu_epi32(vec_i32* a, const vec_i32 b) { _mm_storeu_si128(a, b); }
+
+    inline i32 vec_hsum_epi32(const vec_i32 v) {
+        const auto sum_64 = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        const auto sum_32 = _mm_add_epi32(sum_64, _mm_shuffle_epi32(sum_64, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        return _mm_cvtsi128_si32(sum_32);
+    }
 
     inline uint16_t vec_nnz_mask(const vec_i32 vec) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(vec, _mm_setzero_si128()))); }
 
@@ -177,10 +219,18 @@ namespace Horsie::NNUE {
     inline vec_i16 vec_min_epi16(const vec_i16 a, const vec_i16 b) { return vminq_s16(a, b); }
     inline vec_i16 vec_max_epi16(const vec_i16 a, const vec_i16 b) { return vmaxq_s16(a, b); }
     inline vec_i16 vec_load_epi16(const vec_i16* a) { return vld1q_s16(reinterpret_cast<const i16*>(a)); }
+    inline vec_i16 vec_load_cvtepi8_epi16(const i8* a) { return vmovl_s8(vld1_s8(a)); }
     inline void vec_storeu_i16(vec_i16* a, const vec_i16 b) { vst1q_s16(reinterpret_cast<i16*>(a), b); }
 
     inline vec_i32 vec_set1_epi32(const i32 a) { return vdupq_n_s32(a); }
     inline vec_i32 vec_add_epi32(const vec_i32 a, const vec_i32 b) { return vaddq_s32(a, b); }
+    inline vec_i32 vec_srai_epi32(const vec_i32 a, const i32 i) { return vshlq_s32(a, vdupq_n_s32(-i)); }
+    inline vec_i32 vec_min_epi32(const vec_i32 a, const vec_i32 b) { return vminq_s32(a, b); }
+    inline vec_i32 vec_max_epi32(const vec_i32 a, const vec_i32 b) { return vmaxq_s32(a, b); }
+    inline vec_i32 vec_load_epi32(const vec_i32* a) { return vld1q_s32(reinterpret_cast<const i32*>(a)); }
+    inline void vec_storeu_epi32(vec_i32* a, const vec_i32 b) { vst1q_s32(reinterpret_cast<i32*>(a), b); }
+
+    inline i32 vec_hsum_epi32(const vec_i32 v) { return vaddvq_s32(v); }
 
     inline vec_i16 vec_maddubs_epi16(const vec_i8 a, const vec_i8 b) {
         const auto tl = vmulq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(a))), vmovl_s8(vget_low_s8(b)));
@@ -255,10 +305,21 @@ namespace Horsie::NNUE {
     }
 
 
+    //  With USE_VNNI this is a single vpdpbusd, from AVX512-VNNI or AVX-VNNI depending on the target.
+    //  Otherwise it is emulated with maddubs + madd, which gives the same results since the FT outputs are small enough
+    //  that maddubs never saturates.
     inline vec_i32 vec_dpbusd_epi32(const vec_i32 sum, const vec_i8 vec0, const vec_i8 vec1) {
+#if defined(USE_VNNI) && defined(AVX512)
+        return _mm512_dpbusd_epi32(sum, vec0, vec1);
+#elif defined(USE_VNNI) && defined(AVX256) && defined(__AVXVNNI__)
+        return _mm256_dpbusd_avx_epi32(sum, vec0, vec1);
+#elif defined(USE_VNNI) && defined(AVX256)
+        return _mm256_dpbusd_epi32(sum, vec0, vec1);
+#else
         const vec_i16 product16 = vec_maddubs_epi16(vec0, vec1);
         const vec_i32 product32 = vec_madd_epi16(product16, vec_set1_epi16(1));
         return vec_add_epi32(sum, product32);
+#endif
     }
 
 }
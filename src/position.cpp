@@ -76,6 +76,8 @@ namespace Horsie {
 
         if (UpdateNN) {
             Accumulators.MakeMove(*this, move);
+            if (SmallAccumulators)
+                SmallAccumulators->MakeMove(*this, move);
         }
 
         State.HalfmoveClock++;
@@ -196,6 +198,8 @@ namespace Horsie {
 
         if (UpdateNN) {
             Accumulators.UndoMove();
+            if (SmallAccumulators)
+                SmallAccumulators->UndoMove();
         }
 
         //  Assume that "we" just made the last move, and "they" are undoing it.
@@ -547,6 +551,15 @@ namespace Horsie {
                1 * popcount(bb.Pieces[PAWN]);
     }
 
+    //  White's material minus black's, using the same piece values as move ordering.
+    i32 Position::MaterialImbalance() const {
+        i32 imbalance = 0;
+        for (i32 pt = PAWN; pt < KING; pt++)
+            imbalance += GetPieceValue(pt) * (popcount(bb.Pieces[pt] & bb.Colors[WHITE]) - popcount(bb.Pieces[pt] & bb.Colors[BLACK]));
+
+        return imbalance;
+    }
+
     void Position::RemoveCastling(CastlingStatus cr) {
         Zobrist::Castle(State.Hash, State.CastleStatus, cr);
         State.CastleStatus &= ~cr;
@@ -769,8 +782,23 @@ namespace Horsie {
 
         SetState();
 
+        ResetAccumulators();
+    }
+
+    //  Rebuilds the accumulators from scratch, and allocates or frees the small network's depending on whether one is loaded.
+    void Position::ResetAccumulators() {
+        if (NNUE::HasSmallNetwork() && !SmallAccumulators)
+            SmallAccumulators = std::make_unique<NNUE::AccumulatorStack<NNUE::SmallArch>>(NNUE::SmallNet);
+        else if (!NNUE::HasSmallNetwork())
+            SmallAccumulators.reset();
+
         Accumulators.Reset();
         Accumulators.RefreshIntoCache(*this);
+        if (SmallAccumulators) {
+            SmallAccumulators->Reset();
+            SmallAccumulators->RefreshIntoCache(*this);
+        }
+
         NNUE::ResetCaches(*this);
     }
 
@@ -8,15 +8,19 @@
 #include "types.h"
 #include "util/list.h"
 
+#include <memory>
+
 namespace Horsie {
 
     class Position {
     public:
         Position(const std::string& fen = InitialFEN);
         void LoadFromFEN(const std::string& fen);
+        void ResetAccumulators();
 
-        NNUE::AccumulatorStack Accumulators;
-        NNUE::BucketCache CachedBuckets;
+        NNUE::AccumulatorStack<NNUE::MainArch> Accumulators{ NNUE::MainNet };
+        /// Only allocated while a small network is loaded, see ResetAccumulators
+        std::unique_ptr<NNUE::AccumulatorStack<NNUE::SmallArch>> SmallAccumulators;
         StateInfo State;
 
         Bitboard bb{};
@@ -97,6 +101,7 @@ namespace Horsie {
         bool HasLegalMoves() const;
 
         i32 MaterialCount() const;
+        i32 MaterialImbalance() const;
 
         u64 Perft(i32 depth);
         u64 SplitPerft(i32 depth);
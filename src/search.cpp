@@ -49,6 +49,10 @@ namespace Horsie {
         HardNodeLimit = info.MaxNodes;
         HardTimeLimit = info.MaxSearchTime;
 
+#if defined(TT_STATS)
+        TTShadowSink = &TT->Shadow;
+#endif
+
         SearchStackEntry _SearchStackBlock[MaxPly] = {};
         SearchStackEntry* ss = &_SearchStackBlock[10];
         for (i32 i = -10; i < MaxSearchStackPly; i++) {
@@ -276,7 +280,7 @@ namespace Horsie {
         
         ss->DoubleExtensions = (ss - 1)->DoubleExtensions;
         ss->InCheck = pos.InCheck();
-        ss->TTHit = TT->Probe(pos.Hash(), tte);
+        ss->TTHit = TT->Probe(pos.Hash(), tte, ss->Ply);
         if (!doSkip) {
             ss->TTPV = isPV || (ss->TTHit && tte->PV());
         }
@@ -302,7 +306,7 @@ namespace Horsie {
             eval = ss->StaticEval;
         }
         else if (ss->TTHit) {
-            rawEval = tte->StatEval() != ScoreNone ? tte->StatEval() : NNUE::GetEvaluation(pos);
+            rawEval = tte->StatEval() != ScoreNone ? tte->StatEval() : RawEval(pos, depth);
 
             eval = ss->StaticEval = AdjustEval(pos, rawEval);
 
@@ -310,8 +314,18 @@ namespace Horsie {
                 eval = ttScore;
             }
         }
+        else if (QSTT.Enabled()) {
+            //  Static eval only entries go in the QS table rather than taking a slot in the main one.
+            TTEntry* qte = nullptr;
+            const bool qsHit = QSTT.Probe(pos.Hash(), qte);
+            rawEval = (qsHit && qte->StatEval() != ScoreNone) ? qte->StatEval() : RawEval(pos, depth);
+
+            eval = ss->StaticEval = AdjustEval(pos, rawEval);
+
+            QSTT.Store(qte, pos.Hash(), ScoreNone, TTNodeType::Invalid, TTEntry::DepthNone, Move::Null(), rawEval, TT->Age, ss->TTPV);
+        }
         else {
-            rawEval = NNUE::GetEvaluation(pos);
+            rawEval = RawEval(pos, depth);
 
             eval = ss->StaticEval = AdjustEval(pos, rawEval);
 
@@ -491,8 +505,13 @@ namespace Horsie {
         i32 size = Generate<PseudoLegal>(pos, list, 0);
         AssignScores(pos, ss, list, size, ttMove);
 
-        for (i32 i = 0; i < size; i++) {
-            Move m = OrderNextMove(list, size, i);
+        //  Moves that another thread was already searching when we got to them are put off until the end of the list.
+        Move deferred[MoveListSize];
+        i32 deferredCount = 0;
+        const bool shareWork = ShareWork && !isRoot && depth >= WorkSharingMinDepth;
+
+        for (i32 i = 0; i < size + deferredCount; i++) {
+            Move m = (i < size) ? OrderNextMove(list, size, i) : deferred[i - size];
 
             if (m == ss->Skip) {
                 didSkip = true;
@@ -510,6 +529,15 @@ namespace Horsie {
                     continue;
             }
 
+            //  The first move is always searched, as in ABDADA, since this node can't be cut without it.
+            if (shareWork
+                && i < size
+                && legalMoves > 0
+                && AssocPool->Searching.Contains(pos.HashAfter(m))) {
+                deferred[deferredCount++] = m;
+                continue;
+            }
+
             const auto [moveFrom, moveTo] = m.Unpack();
             const auto theirPiece = bb.GetPieceAtIndex(moveTo);
             const auto ourPiece = bb.GetPieceAtIndex(moveFrom);
@@ -614,7 +642,8 @@ namespace Horsie {
                 }
             }
 
-            prefetch(TT->GetCluster(pos.HashAfter(m)));
+            const u64 childHash = pos.HashAfter(m);
+            prefetch(TT->GetCluster(childHash));
 
             ss->DoubleExtensions = static_cast<i16>((ss - 1)->DoubleExtensions + (extend >= 2 ? 1 : 0));
             CurrentMoves[ss->Ply] = m;
@@ -623,6 +652,9 @@ namespace Horsie {
 
             pos.MakeMove(m);
 
+            if (shareWork)
+                AssocPool->Searching.Mark(childHash);
+
             playedMoves++;
             const u64 prevNodes = Nodes;
 
@@ -686,6 +718,9 @@ namespace Horsie {
 
             pos.UnmakeMove(m);
 
+            if (shareWork)
+                AssocPool->Searching.Unmark(childHash);
+
             if (ShouldStop()) {
                 return ScoreDraw;
             }
@@ -811,7 +846,20 @@ namespace Horsie {
         TTEntry _tte{};
         TTEntry* tte = &_tte;
         ss->InCheck = inCheck;
-        ss->TTHit = TT->Probe(pos.Hash(), tte);
+        ss->TTHit = TT->Probe(pos.Hash(), tte, ss->Ply);
+
+        //  If the main table doesn't have this position, then this node's entry lives in the QS table instead.
+        const bool inQSTable = !ss->TTHit && QSTT.Enabled();
+        if (inQSTable)
+            ss->TTHit = QSTT.Probe(pos.Hash(), tte);
+
+        const auto store = [&](i16 score, TTNodeType bound, i32 depth, Move move, bool pv) {
+            if (inQSTable)
+                QSTT.Store(tte, pos.Hash(), score, bound, depth, move, rawEval, TT->Age, pv);
+            else
+                tte->Update(pos.Hash(), score, bound, depth, move, rawEval, TT->Age, pv);
+        };
+
         const i16 ttScore = ss->TTHit ? MakeNormalScore(tte->Score(), ss->Ply) : ScoreNone;
         const Move ttMove = ss->TTHit ? tte->BestMove : Move::Null();
         bool ttPV = ss->TTHit && tte->PV();
@@ -840,7 +888,7 @@ namespace Horsie {
         }
         else {
             if (ss->TTHit) {
-                rawEval = (tte->StatEval() != ScoreNone) ? tte->StatEval() : NNUE::GetEvaluation(pos);
+                rawEval = (tte->StatEval() != ScoreNone) ? tte->StatEval() : RawEval(pos, 0);
 
                 eval = ss->StaticEval = AdjustEval(pos, rawEval);
 
@@ -849,14 +897,14 @@ namespace Horsie {
                 }
             }
             else {
-                rawEval = (priorMove == Move::Null()) ? (-(ss - 1)->StaticEval) : NNUE::GetEvaluation(pos);
+                rawEval = (priorMove == Move::Null()) ? (-(ss - 1)->StaticEval) : RawEval(pos, 0);
 
                 eval = ss->StaticEval = AdjustEval(pos, rawEval);
             }
 
             if (eval >= beta) {
                 if (!ss->TTHit)
-                    tte->Update(pos.Hash(), MakeTTScore(eval, ss->Ply), TTNodeType::Alpha, TTEntry::DepthNone, Move::Null(), rawEval, TT->Age, false);
+                    store(MakeTTScore(eval, ss->Ply), TTNodeType::Alpha, TTEntry::DepthNone, Move::Null(), false);
 
                 if (std::abs(eval) < ScoreTTWin)
                     eval = static_cast<i16>((4 * eval + beta) / 5);
@@ -947,11 +995,30 @@ namespace Horsie {
 
         TTNodeType bound = (bestScore >= beta) ? TTNodeType::Alpha : TTNodeType::Beta;
 
-        tte->Update(pos.Hash(), MakeTTScore(static_cast<i16>(bestScore), ss->Ply), bound, 0, bestMove, rawEval, TT->Age, ttPV);
+        store(MakeTTScore(static_cast<i16>(bestScore), ss->Ply), bound, 0, bestMove, ttPV);
 
         return bestScore;
     }
 
+    //  If a small network is loaded, it is used for nodes at or below SmallNetDepth (QSearch counts as depth 0),
+    //  and at any depth once the material is lopsided enough that the main network's extra accuracy rarely matters.
+    //  Its evals are cached under the complemented hash so that they don't collide with the main network's.
+    //  Either network's eval can end up in the TT and be reused at other depths, like any other cached eval.
+    i16 SearchThread::RawEval(Position& pos, i32 depth) {
+        const bool useSmall = pos.SmallAccumulators
+                           && (depth <= SmallNetDepth || (SmallNetMaterial != 0 && std::abs(pos.MaterialImbalance()) >= SmallNetMaterial));
+
+        const u64 key = useSmall ? ~pos.Hash() : pos.Hash();
+
+        i16 eval;
+        if (EvalCache.Probe(key, eval))
+            return eval;
+
+        eval = static_cast<i16>(useSmall ? NNUE::GetSmallEvaluation(pos) : NNUE::GetEvaluation(pos));
+        EvalCache.Store(key, eval);
+        return eval;
+    }
+
     void SearchThread::UpdatePV(Move* pv, Move move, Move* childPV) const {
         for (*pv++ = move; childPV != nullptr && *childPV != Move::Null();) {
             *pv++ = *childPV++;
@@ -17,7 +17,6 @@ namespace Horsie {
         RootNode
     };
 
-    class TranspositionTable;
     class Position;
 
     namespace Search {
@@ -9,6 +9,7 @@
 #include "util/timer.h"
 
 #include <chrono>
+#include <iomanip>
 #include <iostream>
 
 using namespace Horsie::Search;
@@ -29,6 +30,8 @@ namespace Horsie {
         limits.MaxSearchTime = INT32_MAX;
 
         u64 totalNodes = 0;
+        TTStats ttStats{};
+        u64 evalProbes = 0, evalHits = 0;
 
         SearchPool.TTable.Clear();
         SearchPool.Clear();
@@ -42,6 +45,11 @@ namespace Horsie {
 
             u64 thisNodeCount = SearchPool.GetNodeCount();
             totalNodes += thisNodeCount;
+            ttStats += SearchPool.GetTTStats();
+
+            const auto [probes, hits] = SearchPool.GetEvalCacheStats();
+            evalProbes += probes;
+            evalHits += hits;
 
             if (!openBench) {
                 std::cout << std::left << std::setw(76) << fen << "\t" << std::to_string(thisNodeCount) << std::endl;
@@ -62,10 +70,66 @@ namespace Horsie {
         }
         else {
             std::cout << std::endl << "Nodes searched: " << totalNodes << " in " << durSeconds << "." << durMillis << " s (" << FormatWithCommas(nps) << " nps)" << std::endl;
+            std::cout << "Eval cache hits: " << FormatWithCommas(evalHits) << " / " << FormatWithCommas(evalProbes)
+                      << " (" << std::fixed << std::setprecision(2) << (evalProbes ? (100.0 * evalHits / evalProbes) : 0.0) << "%)" << std::defaultfloat << std::endl;
             DbgPrint();
+
+#if defined(TT_STATS)
+            ttStats.Print(std::cout);
+#endif
         }
 
         thread->OnDepthFinish = odf;
         thread->OnSearchFinish = osf;
     }
+
+    //  Searches each bench position to the given depth, first as plain Lazy SMP and then with ABDADA work sharing,
+    //  and compares the total time to depth. Runs with the current number of threads, which should be more than 1.
+    //  The node ratio is the number of nodes ABDADA needed relative to Lazy SMP, which is the more useful number
+    //  when there are more threads than cores and the time to depth mostly depends on the total work.
+    inline void DoSMPBench(SearchThreadPool& SearchPool, i32 depth = 12) {
+        Position pos = Position(InitialFEN);
+        SearchThread* thread = SearchPool.MainThread();
+
+        auto odf = thread->OnDepthFinish;
+        auto osf = thread->OnSearchFinish;
+        thread->OnDepthFinish = []() {};
+        thread->OnSearchFinish = []() {};
+
+        SearchLimits limits;
+        limits.MaxDepth = depth;
+        limits.MaxSearchTime = INT32_MAX;
+
+        const auto prevMode = Horsie::ABDADA.CurrentValue;
+        std::array<i64, 2> times{};
+        std::array<u64, 2> nodes{};
+
+        for (i32 mode = 0; mode < 2; mode++) {
+            Horsie::ABDADA = mode;
+
+            for (std::string fen : BenchFENs) {
+                pos.LoadFromFEN(fen);
+
+                SearchPool.TTable.Clear();
+                SearchPool.Clear();
+
+                const auto startTime = Timepoint::Now();
+                SearchPool.StartSearch(pos, limits);
+                SearchPool.WaitForMain();
+
+                times[mode] += Timepoint::TimeSince(startTime);
+                nodes[mode] += SearchPool.GetNodeCount();
+            }
+        }
+
+        Horsie::ABDADA = prevMode;
+        thread->OnDepthFinish = odf;
+        thread->OnSearchFinish = osf;
+
+        std::cout << "Time to depth " << depth << " with " << SearchPool.Threads.size() << " threads:" << std::endl;
+        std::cout << "Lazy SMP:  " << times[0] << " ms, " << FormatWithCommas(nodes[0]) << " nodes" << std::endl;
+        std::cout << "ABDADA:    " << times[1] << " ms, " << FormatWithCommas(nodes[1]) << " nodes" << std::endl;
+        std::cout << "Speedup:   " << std::fixed << std::setprecision(3) << (static_cast<double>(times[0]) / std::max<i64>(times[1], 1)) << std::defaultfloat << std::endl;
+        std::cout << "Node ratio: " << std::fixed << std::setprecision(3) << (static_cast<double>(nodes[1]) / std::max<u64>(nodes[0], 1)) << std::defaultfloat << std::endl;
+    }
 }
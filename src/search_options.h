@@ -7,8 +7,15 @@ namespace Horsie {
 
     UCI_OPTION_SPECIAL(Threads, 1, 1, 2048)
     UCI_OPTION_SPECIAL(Hash, 32, 1, 1048576)
+    UCI_OPTION_SPECIAL(QSHash, 0, 0, 4096)
+    UCI_OPTION_SPECIAL(SharedHash, 0, 0, 65535)
     UCI_OPTION_SPECIAL(MultiPV, 1, 1, 256)
     UCI_OPTION_SPECIAL(MoveOverhead, 25, 1, 5000)
+    UCI_OPTION_SPECIAL(NumaPolicy, 0, 0, 2)
+    UCI_OPTION_SPECIAL(ABDADA, 0, 0, 1)
+    UCI_OPTION_SPECIAL(IntegerLayers, 0, 0, 1)
+    UCI_OPTION_SPECIAL(SmallNetDepth, 0, -1, 64)
+    UCI_OPTION_SPECIAL(SmallNetMaterial, 0, 0, 32000)
     UCI_OPTION_SPIN(UCI_Chess960, false)
     UCI_OPTION_SPIN(UCI_ShowWDL, true)
 
@@ -19,6 +26,8 @@ namespace Horsie {
     const bool UseRFP = true;
     const bool UseProbcut = true;
 
+    const i32 WorkSharingMinDepth = 4;
+
     const i32 CorrectionScale = 1024;
     const i32 CorrectionGrain = 256;
     const i32 CorrectionMax = CorrectionGrain * 64;
@@ -7,6 +7,7 @@
 #include "types.h"
 #include "util.h"
 #include "util/timer.h"
+#include "util/numa.h"
 
 #include <cassert>
 #include <chrono>
@@ -51,6 +52,7 @@ namespace Horsie {
         }
 
         WaitForMain();
+        ResizeQSTables();
     }
 
     void SearchThreadPool::StartSearch(Position& rootPosition, const SearchLimits& rootInfo) {
@@ -82,9 +84,15 @@ namespace Horsie {
             });
         };
 
+        //  Work sharing only makes sense with helpers to share with.
+        const bool shareWork = ABDADA && Threads.size() > 1;
+        if (shareWork)
+            Searching.Clear();
+
         for (auto t : Threads) {
             auto td = t->Worker.get();
             td->Reset();
+            td->ShareWork = shareWork;
 
             td->RootMoves.clear();
             for (i32 j = 0; j < size; j++) {
@@ -125,12 +133,32 @@ namespace Horsie {
     }
 
     void SearchThreadPool::Clear() const {
-        for (i32 i = 0; i < Threads.size(); i++)
+        for (i32 i = 0; i < Threads.size(); i++) {
             Threads[i]->Worker.get()->History.Clear();
+            Threads[i]->Worker.get()->QSTT.Clear();
+            Threads[i]->Worker.get()->EvalCache.Clear();
+        }
 
         MainThread()->Nodes = 0;
     }
 
+    //  Each thread allocates its own QS table, so that it is placed in memory local to that thread.
+    void SearchThreadPool::ResizeQSTables() const {
+        RunOnAllThreads([&](i32 i, i32) { Threads[i]->Worker->QSTT.Initialize(Horsie::QSHash); });
+    }
+
+    //  Runs job(threadIndex, threadCount) on every thread in the pool, and waits for all of them to finish.
+    void SearchThreadPool::RunOnAllThreads(const std::function<void(i32, i32)>& job) const {
+        WaitForMain();
+
+        const auto count = static_cast<i32>(Threads.size());
+        for (i32 i = 0; i < count; i++)
+            Threads[i]->RunJob([&job, i, count] { job(i, count); });
+
+        for (i32 i = 0; i < count; i++)
+            Threads[i]->WaitForThreadFinished();
+    }
+
     bool SearchThread::ShouldStop() const {
         return StopSearching.load(std::memory_order::relaxed);
     }
@@ -160,7 +188,7 @@ namespace Horsie {
         }
     }
 
-    Thread::Thread(i32 n) {
+    Thread::Thread(i32 n) : Index(n) {
         Worker = std::make_unique<SearchThread>();
         SysThread = std::thread(&Thread::IdleLoop, this);
     }
@@ -178,12 +206,25 @@ namespace Horsie {
         CondVar.notify_one();
     }
 
+    void Thread::RunJob(std::function<void()> job) {
+        Mut.lock();
+        Job = std::move(job);
+        Mut.unlock();
+        WakeUp();
+    }
+
     void Thread::WaitForThreadFinished() {
         std::unique_lock<std::mutex> lk(Mut);
         CondVar.wait(lk, [&] { return !Active; });
     }
 
     void Thread::IdleLoop() {
+        //  Threads are spread round-robin over the NUMA nodes, and the TT slices they clear follow the same layout.
+        if (static_cast<Numa::Policy>(NumaPolicy.CurrentValue) != Numa::Policy::None && Numa::NodeCount() > 1)
+            Numa::BindThreadToNode(Index % Numa::NodeCount());
+
+        TTStatsSink = &Worker->TTCounters;
+
         while (true) {
             std::unique_lock<std::mutex> lk(Mut);
             Active = false;
@@ -193,9 +234,14 @@ namespace Horsie {
             if (Quit)
                 return;
 
+            auto job = std::move(Job);
+            Job = nullptr;
             lk.unlock();
 
-            if (Worker->IsMain()) {
+            if (job) {
+                job();
+            }
+            else if (Worker->IsMain()) {
                 Worker->MainThreadSearch();
             }
             else {
@@ -12,6 +12,7 @@ https://github.com/official-stockfish/Stockfish/blob/master/src/thread.h
 */
 
 #include "defs.h"
+#include "evalcache.h"
 #include "history.h"
 #include "move.h"
 #include "position.h"
@@ -45,10 +46,15 @@ namespace Horsie {
         void IdleLoop();
         void WakeUp();
         void WaitForThreadFinished();
+        void RunJob(std::function<void()> job);
 
         std::unique_ptr<SearchThread> Worker;
+        i32 Index;
 
     private:
+        //  Work to do in place of a search the next time this thread wakes up, like clearing its slice of the TT.
+        std::function<void()> Job;
+
         std::mutex Mut;
         std::condition_variable CondVar;
         std::thread SysThread;
@@ -72,9 +78,13 @@ namespace Horsie {
 
         std::atomic_bool StopSearching{};
         bool IsDatagen{};
+        bool ShareWork{};
 
         SearchThreadPool* AssocPool{};
         TranspositionTable* TT{};
+        TTStats TTCounters{};
+        QSTable QSTT{};
+        RawEvalCache EvalCache{};
         Position RootPosition;
         HistoryTable History{};
         std::array<Move, MaxPly> CurrentMoves{};
@@ -107,6 +117,8 @@ namespace Horsie {
         void AssignScores(Position& pos, SearchStackEntry* ss, ScoredMove* list, i32 size, Move ttMove) const;
         Move OrderNextMove(ScoredMove* moves, i32 size, i32 listIndex) const;
 
+        i16 RawEval(Position& pos, i32 depth);
+
         void UpdatePV(Move* pv, Move move, Move* childPV) const;
 
         void UpdateStats(Position& pos, SearchStackEntry* ss, Move bestMove, i32 bestScore, i32 beta, i32 depth, std::span<Move, 16> quietMoves, i32 quietCount, std::span<Move, 16> captureMoves, i32 captureCount);
@@ -125,6 +137,8 @@ namespace Horsie {
 
             ClearContinuations();
             CurrentMoves.fill(Move::Null());
+            TTCounters = {};
+            EvalCache.ResetCounters();
         }
 
         Move CurrentMove() const { return RootMoves[PVIndex].move; }
@@ -185,15 +199,69 @@ namespace Horsie {
         const u32 CheckupFrequency = 1023;
     };
 
+    //  Positions that are currently being searched by some thread, which is used when ABDADA is enabled
+    //  so that other threads can put off searching the same moves and spread out into different subtrees.
+    //  Each slot holds the upper 48 bits of a single hash along with how many threads are searching it, so a position
+    //  stays busy until the last of them unmarks it. Marking a different position that uses the same slot replaces it.
+    class SearchingTable {
+    public:
+        void Mark(u64 hash) {
+            auto& slot = Slot(hash);
+            u64 current = slot.load(std::memory_order::relaxed);
+            u64 desired{};
+            do {
+                const u64 count = (Tag(current) == Tag(hash)) ? std::min(Count(current) + 1, CountMask) : 1;
+                desired = (Tag(hash) << CountBits) | count;
+            } while (!slot.compare_exchange_weak(current, desired, std::memory_order::relaxed));
+        }
+
+        void Unmark(u64 hash) {
+            auto& slot = Slot(hash);
+            u64 current = slot.load(std::memory_order::relaxed);
+            u64 desired{};
+            do {
+                if (Tag(current) != Tag(hash) || Count(current) == 0)
+                    return;
+
+                desired = (Count(current) == 1) ? 0 : current - 1;
+            } while (!slot.compare_exchange_weak(current, desired, std::memory_order::relaxed));
+        }
+
+        bool Contains(u64 hash) const {
+            const u64 current = Slot(hash).load(std::memory_order::relaxed);
+            return Tag(current) == Tag(hash) && Count(current) != 0;
+        }
+
+        void Clear() {
+            for (auto& slot : Slots)
+                slot.store(0, std::memory_order::relaxed);
+        }
+
+    private:
+        static constexpr u64 Size = 1 << 15;
+        static constexpr u64 CountBits = 16;
+        static constexpr u64 CountMask = (1ULL << CountBits) - 1;
+
+        static constexpr u64 Tag(u64 value) { return value >> CountBits; }
+        static constexpr u64 Count(u64 value) { return value & CountMask; }
+
+        std::atomic<u64>& Slot(u64 hash) { return Slots[hash & (Size - 1)]; }
+        const std::atomic<u64>& Slot(u64 hash) const { return Slots[hash & (Size - 1)]; }
+
+        std::array<std::atomic<u64>, Size> Slots{};
+    };
+
     class SearchThreadPool {
     public:
         SearchLimits SharedInfo;
         std::vector<Thread*> Threads;
         TranspositionTable TTable;
+        SearchingTable Searching;
 
         SearchThreadPool(i32 n = 1) {
-            TTable.Initialize(Horsie::Hash);
+            TTable.Executor = [this](const auto& job) { RunOnAllThreads(job); };
             Resize(n);
+            TTable.Initialize(Horsie::Hash);
         }
 
         constexpr SearchThread* MainThread() const { return Threads.front()->Worker.get(); }
@@ -222,6 +290,25 @@ namespace Horsie {
         void AwakenHelperThreads() const;
         void WaitForSearchFinished() const;
         void Clear() const;
+        void ResizeQSTables() const;
+        void RunOnAllThreads(const std::function<void(i32, i32)>& job) const;
+
+        TTStats GetTTStats() const {
+            TTStats sum{};
+            for (auto& td : Threads) {
+                sum += td->Worker.get()->TTCounters;
+            }
+            return sum;
+        }
+
+        std::pair<u64, u64> GetEvalCacheStats() const {
+            u64 probes = 0, hits = 0;
+            for (auto& td : Threads) {
+                probes += td->Worker.get()->EvalCache.Probes;
+                hits += td->Worker.get()->EvalCache.Hits;
+            }
+            return { probes, hits };
+        }
 
         u64 GetNodeCount() const {
             u64 sum = 0;
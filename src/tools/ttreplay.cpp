@@ -0,0 +1,305 @@
+
+//  Replays a TT trace written by the "tttrace" command against simulated tables, so that table sizes,
+//  cluster layouts and replacement rules can be compared without rebuilding or rerunning the engine.
+//  Traces are only recorded by engines built with TT_TRACE defined in tt.h.
+//
+//  Usage: ttreplay <trace> [mb=32,128] [layout=3x16,5x32] [update=default,always,depth] [victim=quality,depth,age]
+//
+//  Each option takes a comma separated list, and every combination of them is simulated.
+//  The "default" update rule with the "quality" victim rule is the same as TTEntry::Update and TranspositionTable::Probe,
+//  so those rows match the output of "ttbench" for the 3x16 (32 byte) and 5x32 (64 byte) layouts.
+
+#include "../tt_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace Horsie;
+
+namespace {
+
+    enum class UpdateRule {
+        /// Same as TTEntry::Update
+        Default,
+        /// Every store overwrites the entry
+        Always,
+        /// Stores only overwrite entries for the same position if they are at least as deep
+        Depth
+    };
+
+    enum class VictimRule {
+        /// Same as TranspositionTable::Probe, the entry with the lowest depth minus relative age
+        Quality,
+        /// The entry with the lowest depth
+        Depth,
+        /// The entry from the oldest search, and the lowest depth within that
+        Age
+    };
+
+    struct SimConfig {
+        i32 MB;
+        i32 Entries;
+        i32 KeyBits;
+        UpdateRule Update;
+        VictimRule Victim;
+    };
+
+    //  A cluster's entries are stored separately from the keys so that any entry count and key width can be simulated.
+    //  RawDepth and AgePVType are packed the same way they are in TTEntry.
+    struct SimEntry {
+        u8 RawDepth;
+        u8 AgePVType;
+    };
+
+    constexpr i32 DepthOffset = -7;
+    constexpr i32 AgeInc = 0x8;
+    constexpr i32 AgeMask = 0xF8;
+    constexpr i32 AgeCycle = 255 + AgeInc;
+
+    constexpr i32 RelAge(const SimEntry& e, u8 age) { return static_cast<i8>((AgeCycle + age - e.AgePVType) & AgeMask); }
+
+    //  The byte size of a cluster in the engine's layout, with 8 bytes of data per entry plus the key and a u16 generation.
+    i32 ClusterBytes(i32 entries, i32 keyBits) {
+        const i32 used = entries * (8 + keyBits / 8) + 2;
+        i32 bytes = 1;
+        while (bytes < used)
+            bytes <<= 1;
+        return bytes;
+    }
+
+    class SimTable {
+    public:
+        SimTable(const SimConfig& cfg) : Config(cfg) {
+            ClusterCount = static_cast<u64>(cfg.MB) * 0x100000ULL / ClusterBytes(cfg.Entries, cfg.KeyBits);
+            KeyMask = (cfg.KeyBits >= 64) ? ~0ULL : ((1ULL << cfg.KeyBits) - 1);
+
+            Keys.resize(ClusterCount * cfg.Entries);
+            Entries.resize(ClusterCount * cfg.Entries);
+            Hashes.resize(ClusterCount * cfg.Entries);
+        }
+
+        void Clear() {
+            std::fill(Keys.begin(), Keys.end(), 0);
+            std::fill(Entries.begin(), Entries.end(), SimEntry{});
+            std::fill(Hashes.begin(), Hashes.end(), 0);
+            Age = 0;
+        }
+
+        void NewSearch() { Age = static_cast<u8>(Age + AgeInc); }
+
+        //  Returns the slot that a probe for this hash lands on, and whether it was a hit.
+        std::pair<u64, bool> Probe(u64 hash) const {
+            const u64 base = static_cast<u64>((static_cast<uint128_t>(hash) * static_cast<uint128_t>(ClusterCount)) >> 64) * Config.Entries;
+            const u64 key = hash & KeyMask;
+
+            for (i32 i = 0; i < Config.Entries; i++) {
+                if (Keys[base + i] == key || Entries[base + i].RawDepth == 0)
+                    return { base + i, Entries[base + i].RawDepth != 0 };
+            }
+
+            u64 replace = base;
+            for (i32 i = 1; i < Config.Entries; i++) {
+                if (Worse(Entries[base + i], Entries[replace]))
+                    replace = base + i;
+            }
+
+            return { replace, false };
+        }
+
+        void Store(u64 slot, const TTAccess& op) {
+            const u64 key = op.Hash & KeyMask;
+            SimEntry& e = Entries[slot];
+            const i32 oldDepth = e.RawDepth + DepthOffset;
+
+            bool write = true;
+            if (Config.Update == UpdateRule::Default) {
+                write = static_cast<TTNodeType>(op.Bound) == TTNodeType::Exact
+                     || key != Keys[slot]
+                     || Age != (e.AgePVType & AgeMask)
+                     || op.Depth + (2 * op.PV) > oldDepth - 4;
+            }
+            else if (Config.Update == UpdateRule::Depth) {
+                write = key != Keys[slot] || e.RawDepth == 0 || op.Depth >= oldDepth;
+            }
+
+            if (!write)
+                return;
+
+            Keys[slot] = key;
+            Hashes[slot] = op.Hash;
+            e.RawDepth = static_cast<u8>(op.Depth - DepthOffset);
+            e.AgePVType = static_cast<u8>(Age | ((op.PV ? 1u : 0u) << 2) | op.Bound);
+        }
+
+        u64 HashAt(u64 slot) const { return Hashes[slot]; }
+
+    private:
+        //  Returns true if a should be replaced before b.
+        bool Worse(const SimEntry& a, const SimEntry& b) const {
+            switch (Config.Victim) {
+            case VictimRule::Depth:
+                return a.RawDepth < b.RawDepth;
+            case VictimRule::Age:
+                return RelAge(a, Age) != RelAge(b, Age) ? RelAge(a, Age) > RelAge(b, Age) : a.RawDepth < b.RawDepth;
+            default:
+                return (b.RawDepth - RelAge(b, Age)) > (a.RawDepth - RelAge(a, Age));
+            }
+        }
+
+        SimConfig Config;
+        u64 ClusterCount{};
+        u64 KeyMask{};
+        u8 Age{};
+
+        std::vector<u64> Keys{};
+        std::vector<SimEntry> Entries{};
+        //  The full hash of each stored entry, which is only used to count false hits.
+        std::vector<u64> Hashes{};
+    };
+
+    struct SimResult {
+        u64 Probes{};
+        u64 Hits{};
+        u64 FalseHits{};
+        double Seconds{};
+    };
+
+    SimResult Replay(const std::vector<TTAccess>& trace, const SimConfig& cfg) {
+        SimTable tt(cfg);
+        SimResult result{};
+
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& op : trace) {
+            switch (op.Type) {
+            case TTAccess::Kind::Probe: {
+                const auto [slot, hit] = tt.Probe(op.Hash);
+                result.Probes++;
+                if (hit) {
+                    result.Hits++;
+                    if (tt.HashAt(slot) != op.Hash)
+                        result.FalseHits++;
+                }
+                break;
+            }
+            case TTAccess::Kind::Store:
+                tt.Store(tt.Probe(op.Hash).first, op);
+                break;
+            case TTAccess::Kind::NewSearch:
+                tt.NewSearch();
+                break;
+            case TTAccess::Kind::Clear:
+                tt.Clear();
+                break;
+            }
+        }
+        result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return result;
+    }
+
+    std::vector<std::string> SplitList(const std::string& str) {
+        std::vector<std::string> parts{};
+        std::stringstream ss(str);
+        std::string part;
+        while (std::getline(ss, part, ','))
+            if (!part.empty())
+                parts.push_back(part);
+
+        return parts;
+    }
+
+    const char* Name(UpdateRule r) { return r == UpdateRule::Always ? "always" : r == UpdateRule::Depth ? "depth" : "default"; }
+    const char* Name(VictimRule r) { return r == VictimRule::Depth ? "depth" : r == VictimRule::Age ? "age" : "quality"; }
+}
+
+i32 main(i32 argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: ttreplay <trace> [mb=32,128] [layout=3x16,5x32] [update=default,always,depth] [victim=quality,depth,age]" << std::endl;
+        return 1;
+    }
+
+    std::vector<TTAccess> trace{};
+    if (!ReadTTTrace(argv[1], trace)) {
+        std::cout << "Failed to read a TT trace from " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<i32> sizes = { 32 };
+    std::vector<std::pair<i32, i32>> layouts = { { 3, 16 }, { 5, 32 } };
+    std::vector<UpdateRule> updates = { UpdateRule::Default };
+    std::vector<VictimRule> victims = { VictimRule::Quality };
+
+    for (i32 i = 2; i < argc; i++) {
+        const std::string arg = argv[i];
+        const auto eq = arg.find('=');
+        const auto name = arg.substr(0, eq);
+        const auto values = (eq == std::string::npos) ? std::vector<std::string>{} : SplitList(arg.substr(eq + 1));
+
+        if (name == "mb") {
+            sizes.clear();
+            for (const auto& v : values)
+                sizes.push_back(std::max(1, std::stoi(v)));
+        }
+        else if (name == "layout") {
+            layouts.clear();
+            for (const auto& v : values) {
+                const auto x = v.find('x');
+                const i32 entries = std::clamp(std::stoi(v.substr(0, x)), 1, 16);
+                const i32 bits = (x == std::string::npos) ? 16 : std::stoi(v.substr(x + 1));
+                layouts.push_back({ entries, std::clamp(bits, 8, 64) });
+            }
+        }
+        else if (name == "update") {
+            updates.clear();
+            for (const auto& v : values)
+                updates.push_back(v == "always" ? UpdateRule::Always : v == "depth" ? UpdateRule::Depth : UpdateRule::Default);
+        }
+        else if (name == "victim") {
+            victims.clear();
+            for (const auto& v : values)
+                victims.push_back(v == "depth" ? VictimRule::Depth : v == "age" ? VictimRule::Age : VictimRule::Quality);
+        }
+        else {
+            std::cout << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    u64 probes = 0, stores = 0, searches = 0;
+    for (const auto& op : trace) {
+        probes += (op.Type == TTAccess::Kind::Probe);
+        stores += (op.Type == TTAccess::Kind::Store);
+        searches += (op.Type == TTAccess::Kind::NewSearch);
+    }
+
+    std::cout << "Trace has " << trace.size() << " accesses: " << probes << " probes, " << stores << " stores, " << searches << " searches" << std::endl << std::endl;
+
+    std::cout << std::left << std::setw(8) << "MB" << std::setw(10) << "Layout" << std::setw(10) << "Bytes"
+              << std::setw(10) << "Update" << std::setw(10) << "Victim"
+              << std::setw(10) << "Hit %" << std::setw(14) << "False hit %" << "Ops/sec" << std::endl;
+
+    for (i32 mb : sizes) {
+        for (const auto& [entries, bits] : layouts) {
+            for (UpdateRule update : updates) {
+                for (VictimRule victim : victims) {
+                    const SimConfig cfg = { mb, entries, bits, update, victim };
+                    const auto result = Replay(trace, cfg);
+
+                    const auto p = static_cast<double>(std::max<u64>(result.Probes, 1));
+                    std::cout << std::left << std::setw(8) << mb
+                              << std::setw(10) << (std::to_string(entries) + "x" + std::to_string(bits))
+                              << std::setw(10) << ClusterBytes(entries, bits)
+                              << std::setw(10) << Name(update) << std::setw(10) << Name(victim)
+                              << std::setw(10) << std::fixed << std::setprecision(2) << (100.0 * result.Hits / p)
+                              << std::setw(14) << std::setprecision(4) << (100.0 * result.FalseHits / p)
+                              << static_cast<u64>(trace.size() / std::max(result.Seconds, 1e-9)) << std::endl;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
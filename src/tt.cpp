@@ -1,24 +1,105 @@
 
 #include "tt.h"
 
+#include "search_options.h"
 #include "util/alloc.h"
+#include "util/numa.h"
 
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <thread>
 #include <vector>
 
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace Horsie {
 
-    bool TranspositionTable::Probe(u64 hash, TTEntry*& tte) const {
-        TTCluster* const cluster = GetCluster(hash);
-        tte = (TTEntry*)cluster;
+    namespace {
+
+        //  Written at the start of savehash files, and followed by the raw Clusters array.
+        struct SnapshotHeader {
+            u64 Magic;
+            u32 Version;
+            u32 ClusterSize;
+            u64 ClusterCount;
+            u8 Age;
+            u8 _pad0;
+            u16 Generation;
+            u8 _pad1[4];
+        };
+
+        constexpr u64 SnapshotMagic = 0x48534854'41424C45;  //  "HSHTABLE"
+        constexpr u32 SnapshotVersion = 2;
+
+        //  Placed at the start of a shared table's segment, and followed by the clusters at SharedHeaderSize.
+        struct SharedHeader {
+            u64 Magic;
+            u32 ClusterSize;
+            u16 Generation;
+            u8 Age;
+            u8 _pad;
+            u64 ClusterCount;
+            std::atomic<u32> Attached;
+        };
+
+        constexpr u64 SharedMagic = 0x48534854'53484D31;  //  "HSHTSHM1"
+        constexpr nuint SharedHeaderSize = 4096;
+
+        //  The cluster index of a hash is its position within [0, 2^64) scaled to the number of clusters,
+        //  so an entry in cluster i of a table with 'from' clusters has a hash somewhere within [i / from, (i + 1) / from).
+        //  Without the full hash, the best guess for its index in a table with 'to' clusters is the middle of that range.
+        constexpr u64 RescaleIndex(u64 i, u64 from, u64 to) {
+            return static_cast<u64>(((2 * static_cast<uint128_t>(i) + 1) * to) / (2 * static_cast<uint128_t>(from)));
+        }
+
+        //  Returns the first cluster in a table of size 'from' that RescaleIndex places at or after index 'target'.
+        u64 FirstSourceFor(u64 target, u64 from, u64 to) {
+            u64 i = static_cast<u64>((static_cast<uint128_t>(target) * from) / to);
+            while (i > 0 && RescaleIndex(i - 1, from, to) >= target)
+                i--;
+            while (i < from && RescaleIndex(i, from, to) < target)
+                i++;
+            return i;
+        }
+    }
+
+    template <typename Layout>
+    bool TranspositionTableBase<Layout>::Probe(u64 hash, Entry*& tte, i32 ply) {
+        Cluster* const cluster = GetCluster(hash);
+        Refresh(cluster);
+        tte = (Entry*)cluster;
+
+        auto key = static_cast<typename Layout::Key>(hash);
 
-        auto key = static_cast<u16>(hash);
+#if defined(TT_TRACE)
+        if (TTTraceSink)
+            TTTraceSink->push_back({ .Hash = hash, .Type = TTAccess::Kind::Probe, .Ply = static_cast<i16>(ply) });
+#endif
 
-        for (i32 i = 0; i < TTCluster::EntriesPerCluster; i++) {
+        for (i32 i = 0; i < Layout::EntriesPerCluster; i++) {
             //  If the entry's key matches, or the entry is empty, then pick this one.
             if (tte[i].Key == key || tte[i].IsEmpty()) {
                 tte = &tte[i];
 
+#if defined(TT_STATS)
+                if (TTStatsSink) {
+                    TTStatsSink->Probes++;
+                    (tte[0].IsEmpty() ? TTStatsSink->EmptySlots : TTStatsSink->Hits)++;
+
+                    const u64* full = tte[0].IsEmpty() ? nullptr : Shadow.Find(tte);
+                    TTStatsSink->FalseHits += (full != nullptr && *full != 0 && *full != hash);
+                }
+#endif
+
                 //  We return true if the entry isn't empty, which means that tte is valid.
                 //  Check tte[0] here, not tte[i].
                 return !tte[0].IsEmpty();
@@ -29,56 +110,336 @@ namespace Horsie {
         //  non-working entries in this cluster to possibly be overwritten / updated, and return false.
 
         //  Replace the first entry, unless the 2nd or 3rd is a better option.
-        TTEntry* replace = tte;
-        for (i32 i = 1; i < TTCluster::EntriesPerCluster; i++) {
+        Entry* replace = tte;
+        for (i32 i = 1; i < Layout::EntriesPerCluster; i++) {
             if (replace->Quality(Age) > tte[i].Quality(Age)) {
                 replace = &tte[i];
             }
         }
 
         tte = replace;
+
+#if defined(TT_STATS)
+        if (TTStatsSink) {
+            TTStatsSink->Probes++;
+            TTStatsSink->FullClusterMisses++;
+        }
+#endif
+
+        return false;
+    }
+
+    template <typename Layout>
+    TranspositionTableBase<Layout>::~TranspositionTableBase() {
+        Release();
+    }
+
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::Release() {
+#if defined(TT_STATS)
+        Shadow.Reset(nullptr, 0, sizeof(Entry));
+#endif
+
+        if (!IsShared()) {
+            LargePageFree(Clusters, sizeof(Cluster) * ClusterCount, AllocKind);
+            Clusters = nullptr;
+            return;
+        }
+
+#if defined(__linux__) || defined(__APPLE__)
+        //  The last process to detach removes the segment, otherwise it would outlive all of them.
+        auto header = static_cast<SharedHeader*>(SharedBase);
+        const bool last = header->Attached.fetch_sub(1) == 1;
+
+        munmap(SharedBase, SharedHeaderSize + sizeof(Cluster) * ClusterCount);
+        if (last)
+            shm_unlink(SharedName.c_str());
+#endif
+
+        SharedBase = nullptr;
+        Clusters = nullptr;
+        AllocKind = PageKind::Normal;
+    }
+
+    //  Backs the table with the POSIX shared memory segment "/horsie-tt-<id>", creating it with 'mb' megabytes if it
+    //  doesn't exist yet. If another process already created it, the table takes on that segment's size instead.
+    //  Clearing a shared table starts a new generation in the segment's header, which the other processes pick up in TTUpdate.
+    //  Only the process whose O_EXCL open succeeds sizes the segment and fills in its header, and the others wait for that
+    //  to finish and check that the segment really is as large as its header says before mapping all of it.
+    template <typename Layout>
+    bool TranspositionTableBase<Layout>::AttachShared(i32 id, i32 mb) {
+#if defined(__linux__) || defined(__APPLE__)
+        const std::string name = "/horsie-tt-" + std::to_string(id);
+
+        //  Polls until ready() returns true, and gives up after about a second in case the creator died halfway through.
+        const auto waitFor = [](const auto& ready) {
+            for (i32 i = 0; i < 1000; i++) {
+                if (ready())
+                    return true;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            return ready();
+        };
+
+        i32 fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        const bool created = (fd >= 0);
+        if (!created) {
+            if (errno != EEXIST)
+                return false;
+
+            fd = shm_open(name.c_str(), O_RDWR, 0600);
+            if (fd < 0)
+                return false;
+        }
+
+        const auto fail = [&]() {
+            close(fd);
+            if (created)
+                shm_unlink(name.c_str());
+
+            return false;
+        };
+
+        const auto segmentSize = [fd]() -> i64 {
+            struct stat st {};
+            return (fstat(fd, &st) == 0) ? static_cast<i64>(st.st_size) : -1;
+        };
+
+        u64 count = u64(mb) * 1024 * 1024 / sizeof(Cluster);
+        if (created && ftruncate(fd, static_cast<off_t>(SharedHeaderSize + sizeof(Cluster) * count)) != 0)
+            return fail();
+
+        if (!waitFor([&]() { return segmentSize() >= static_cast<i64>(SharedHeaderSize); }))
+            return fail();
+
+        //  Map just the header first to find out how large an existing table is.
+        auto header = static_cast<SharedHeader*>(mmap(nullptr, SharedHeaderSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        if (header == MAP_FAILED)
+            return fail();
+
+        auto magic = std::atomic_ref<u64>(header->Magic);
+        if (created) {
+            header->ClusterSize = sizeof(Cluster);
+            header->ClusterCount = count;
+            header->Generation = 0;
+            header->Age = 0;
+            magic.store(SharedMagic, std::memory_order::release);
+        }
+        else if (!waitFor([&]() { return magic.load(std::memory_order::acquire) == SharedMagic; })) {
+            munmap(header, SharedHeaderSize);
+            return fail();
+        }
+
+        const bool compatible = header->ClusterSize == sizeof(Cluster);
+        count = header->ClusterCount;
+        munmap(header, SharedHeaderSize);
+
+        const nuint bytes = SharedHeaderSize + sizeof(Cluster) * count;
+        if (!compatible || segmentSize() != static_cast<i64>(bytes))
+            return fail();
+
+        void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (base == MAP_FAILED) {
+            if (created)
+                shm_unlink(name.c_str());
+
+            return false;
+        }
+
+        Release();
+
+        header = static_cast<SharedHeader*>(base);
+        header->Attached.fetch_add(1);
+
+        SharedBase = base;
+        SharedName = name;
+        AllocKind = PageKind::Shared;
+        ClusterCount = count;
+        Clusters = reinterpret_cast<Cluster*>(static_cast<char*>(base) + SharedHeaderSize);
+        Generation = std::atomic_ref<u16>(header->Generation).load(std::memory_order::relaxed);
+        Age = std::atomic_ref<u8>(header->Age).load(std::memory_order::relaxed);
+
+        return true;
+#else
         return false;
+#endif
     }
 
-    void TranspositionTable::Initialize(i32 mb) {
-        if (Clusters) {
-            AlignedFree(Clusters);
+    //  A shared table's age and generation live in its header, so a new search in any of the attached processes ages everyone's
+    //  entries the same way, and a Clear in any of them clears the table for all of them. Processes that are already searching
+    //  keep using the age and generation they started with until their next search.
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::TTUpdate() {
+        if (IsShared()) {
+            auto header = static_cast<SharedHeader*>(SharedBase);
+            Age = static_cast<u8>(std::atomic_ref<u8>(header->Age).fetch_add(Entry::TT_AGE_INC, std::memory_order::relaxed) + Entry::TT_AGE_INC);
+            Generation = std::atomic_ref<u16>(header->Generation).load(std::memory_order::relaxed);
+        }
+        else {
+            Age += Entry::TT_AGE_INC;
         }
 
-        u64 size = u64(mb) * 1024 * 1024 / sizeof(TTCluster);
+#if defined(TT_TRACE)
+        if (TTTraceSink)
+            TTTraceSink->push_back({ .Type = TTAccess::Kind::NewSearch });
+#endif
+    }
+
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::Initialize(i32 mb) {
+        Release();
+
+        u64 size = u64(mb) * 1024 * 1024 / sizeof(Cluster);
         ClusterCount = size;
-        Clusters = AlignedAlloc<TTCluster>(ClusterCount);
+        Clusters = LargePageAlloc<Cluster>(ClusterCount, AllocKind);
 
-        Clear();
+#if defined(TT_STATS)
+        Shadow.Reset(Clusters, sizeof(Cluster) * ClusterCount, sizeof(Entry));
+#endif
+
+        ClearFull();
     }
 
-    void TranspositionTable::Clear() {
+    //  Changes the size of the table while keeping as much of its contents as possible.
+    //  The live entries of the old table are moved into the new one in parallel, see ImportClusters.
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::Resize(i32 mb) {
+        const u64 newCount = u64(mb) * 1024 * 1024 / sizeof(Cluster);
+        if (Clusters == nullptr) {
+            Initialize(mb);
+            return;
+        }
 
-        const auto numThreads = Horsie::Threads.CurrentValue;
-        const u64 clustersPerThread = (ClusterCount / static_cast<u64>(numThreads));
-        std::vector<std::thread> threads{};
+        //  A shared table's size is decided by whoever created the segment.
+        if (newCount == ClusterCount || IsShared())
+            return;
 
-        for (i32 i = 0; i < numThreads; ++i) {
-            threads.emplace_back([this, clustersPerThread, numThreads, i] {
-                const u64 start = clustersPerThread * static_cast<u64>(i);
-                const u64 length = (i == numThreads - 1) ? ClusterCount - start : clustersPerThread;
+        Cluster* const oldClusters = Clusters;
+        const u64 oldCount = ClusterCount;
+        const PageKind oldKind = AllocKind;
+        const u8 oldAge = Age;
+        const u16 oldGeneration = Generation;
 
-                std::memset(&Clusters[start], 0, sizeof(TTCluster) * length);
-            });
+        ClusterCount = newCount;
+        Clusters = LargePageAlloc<Cluster>(ClusterCount, AllocKind);
+        ClearFull();
+
+        ImportClusters(oldClusters, oldCount, oldAge, oldGeneration);
+        LargePageFree(oldClusters, sizeof(Cluster) * oldCount, oldKind);
+    }
+
+    //  Starts a new generation, which makes every existing cluster read as empty the next time it is probed.
+    //  This takes constant time regardless of the table size, except once every 65536 calls when the
+    //  generation wraps around and stale clusters could otherwise look current again.
+    //  A shared table's generation is bumped in its header, and its age is left alone since the other processes share it.
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::Clear() {
+        if (IsShared()) {
+            auto header = static_cast<SharedHeader*>(SharedBase);
+            Generation = static_cast<u16>(std::atomic_ref<u16>(header->Generation).fetch_add(1, std::memory_order::relaxed) + 1);
         }
+        else {
+            Age = 0;
+            ++Generation;
+        }
+
+        if (Generation == 0)
+            ClearFull();
+    }
+
+    //  A shared table's pages are left where they are, since its placement is up to the process that created it.
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::ClearFull() {
+        const auto policy = IsShared() ? Numa::Policy::None : static_cast<Numa::Policy>(NumaPolicy.CurrentValue);
+
+        if (policy == Numa::Policy::Interleave)
+            Numa::Interleave(Clusters, sizeof(Cluster) * ClusterCount);
+
+        const auto clearSlice = [this, policy](i32 i, i32 numThreads) {
+            const auto [start, length] = Slice(i, numThreads);
+
+            if (policy == Numa::Policy::Local)
+                Numa::Prefer(&Clusters[start], sizeof(Cluster) * length, i % Numa::NodeCount());
+
+            std::memset(&Clusters[start], 0, sizeof(Cluster) * length);
+        };
+
+        RunParallel(clearSlice);
+
+        if (!IsShared())
+            Age = 0;
+
+        Generation = 0;
+    }
+
+    //  Applies the current NumaPolicy to the pages the table already has, which the kernel migrates without changing their contents.
+    //  Under the local policy, each thread's slice is moved to the node that thread is bound to.
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::PlaceClusters() {
+        if (IsShared() || Clusters == nullptr)
+            return;
+
+        const auto policy = static_cast<Numa::Policy>(NumaPolicy.CurrentValue);
+        const auto bytes = sizeof(Cluster) * ClusterCount;
+
+        if (policy == Numa::Policy::None) {
+            Numa::ResetPolicy(Clusters, bytes);
+        }
+        else if (policy == Numa::Policy::Interleave) {
+            Numa::Interleave(Clusters, bytes);
+        }
+        else {
+            const i32 numThreads = Horsie::Threads.CurrentValue;
+            for (i32 i = 0; i < numThreads; i++) {
+                const auto [start, length] = Slice(i, numThreads);
+                Numa::Prefer(&Clusters[start], sizeof(Cluster) * length, i % Numa::NodeCount());
+            }
+        }
+    }
+
+    //  Returns the first cluster and cluster count of thread i's share of the table.
+    //  Slices are rounded to whole huge pages so that a single page is never split between two nodes.
+    template <typename Layout>
+    std::pair<u64, u64> TranspositionTableBase<Layout>::Slice(i32 i, i32 numThreads) const {
+        constexpr u64 clustersPerPage = HugePageSize / sizeof(Cluster);
+        const u64 pages = (ClusterCount + clustersPerPage - 1) / clustersPerPage;
+        const u64 clustersPerThread = ((pages + numThreads - 1) / numThreads) * clustersPerPage;
+
+        const u64 start = std::min(ClusterCount, clustersPerThread * static_cast<u64>(i));
+        const u64 length = (i == numThreads - 1) ? ClusterCount - start : std::min(clustersPerThread, ClusterCount - start);
+        return { start, length };
+    }
+
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::RunParallel(const std::function<void(i32, i32)>& job) const {
+        if (Executor) {
+            Executor(job);
+            return;
+        }
+
+        const auto numThreads = Horsie::Threads.CurrentValue;
+        std::vector<std::thread> threads{};
+
+        for (i32 i = 0; i < numThreads; ++i)
+            threads.emplace_back(job, i, numThreads);
 
         for (auto& thread : threads)
             thread.join();
-
-        Age = 0;
     }
 
-    u32 TranspositionTable::Hashfull() const {
+    template <typename Layout>
+    u32 TranspositionTableBase<Layout>::Hashfull() const {
         u32 entries = 0;
         for (size_t i = 0; i < 1000; i++) {
             const auto& cluster = Clusters[i];
+            if (cluster.Generation != Generation)
+                continue;
 
-            for (size_t j = 0; j < TTCluster::EntriesPerCluster; j++) {
+            for (size_t j = 0; j < Layout::EntriesPerCluster; j++) {
                 const auto e = cluster.entries[j];
 
                 if (!e.IsEmpty() && e.Age() == Age)
@@ -86,11 +447,214 @@ namespace Horsie {
             }
         }
 
-        return entries / TTCluster::EntriesPerCluster;
+        return entries / Layout::EntriesPerCluster;
+    }
+
+    //  Counts the entries in the entire table, rather than the sample that Hashfull looks at.
+    template <typename Layout>
+    u64 TranspositionTableBase<Layout>::CountEntries(bool currentAgeOnly) const {
+        u64 entries = 0;
+        for (u64 i = 0; i < ClusterCount; i++) {
+            const auto& cluster = Clusters[i];
+            if (cluster.Generation != Generation)
+                continue;
+
+            for (const auto& e : cluster.entries) {
+                if (!e.IsEmpty() && (!currentAgeOnly || e.Age() == Age))
+                    entries++;
+            }
+        }
+
+        return entries;
+    }
+
+    template <typename Layout>
+    std::string TranspositionTableBase<Layout>::AllocationInfo() const {
+        const auto bytes = sizeof(Cluster) * ClusterCount;
+
+        std::ostringstream oss;
+        oss << "hash uses " << PageKindName(AllocKind);
+
+        if (IsShared())
+            oss << " " << SharedName << " (" << (bytes / (1024 * 1024)) << " MB)";
+
+        if (AllocKind == PageKind::Transparent) {
+            //  madvise only asks for huge pages, so report how much of the table the kernel actually gave us.
+            const auto hugeBytes = TransparentHugeBytes(Clusters, bytes);
+            oss << " (" << (hugeBytes / (1024 * 1024)) << " of " << (bytes / (1024 * 1024)) << " MB backed by huge pages)";
+        }
+
+        return oss.str();
     }
 
-    void TTEntry::Update(u64 key, i16 score, TTNodeType nodeType, i32 depth, Move move, i16 statEval, u8 age, bool isPV) {
-        u16 k = static_cast<u16>(key);
+    template <typename Layout>
+    std::string TranspositionTableBase<Layout>::NumaInfo() const {
+        const auto counts = Numa::PagesPerNode(Clusters, sizeof(Cluster) * ClusterCount);
+
+        std::ostringstream oss;
+        oss << "hash pages per node:";
+        for (size_t i = 0; i < counts.size(); i++)
+            oss << " " << i << ":" << counts[i];
+
+        return oss.str();
+    }
+
+    template <typename Layout>
+    bool TranspositionTableBase<Layout>::Save(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        SnapshotHeader header{};
+        header.Magic = SnapshotMagic;
+        header.Version = SnapshotVersion;
+        header.ClusterSize = sizeof(Cluster);
+        header.ClusterCount = ClusterCount;
+        header.Age = Age;
+        header.Generation = Generation;
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(Clusters), static_cast<std::streamsize>(sizeof(Cluster) * ClusterCount));
+        return file.good();
+    }
+
+    //  Shared tables can't be loaded into, since that would overwrite the entries that the other processes are using
+    //  and give this process a generation that they don't have.
+    template <typename Layout>
+    bool TranspositionTableBase<Layout>::Load(const std::string& path) {
+        if (IsShared())
+            return false;
+
+#if defined(__linux__) || defined(__APPLE__)
+        const i32 fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || static_cast<nuint>(st.st_size) < sizeof(SnapshotHeader)) {
+            close(fd);
+            return false;
+        }
+
+        const auto fileSize = static_cast<nuint>(st.st_size);
+        void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (mapped == MAP_FAILED)
+            return false;
+
+        madvise(mapped, fileSize, MADV_SEQUENTIAL);
+        const auto data = static_cast<const char*>(mapped);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+
+        const auto fileSize = static_cast<nuint>(file.tellg());
+        std::vector<char> buffer(fileSize);
+        file.seekg(0);
+        file.read(buffer.data(), static_cast<std::streamsize>(fileSize));
+
+        if (!file || fileSize < sizeof(SnapshotHeader))
+            return false;
+
+        const auto data = buffer.data();
+#endif
+
+        SnapshotHeader header{};
+        std::memcpy(&header, data, sizeof(header));
+
+        const bool valid = header.Magic == SnapshotMagic
+                        && header.Version == SnapshotVersion
+                        && header.ClusterSize == sizeof(Cluster)
+                        && header.ClusterCount != 0
+                        && fileSize == sizeof(SnapshotHeader) + sizeof(Cluster) * header.ClusterCount;
+
+        if (valid) {
+            const auto src = reinterpret_cast<const Cluster*>(data + sizeof(SnapshotHeader));
+            ImportClusters(src, header.ClusterCount, header.Age, header.Generation);
+        }
+
+#if defined(__linux__) || defined(__APPLE__)
+        munmap(mapped, fileSize);
+#endif
+
+        return valid;
+    }
+
+    //  Replaces the contents of the table with the clusters in src.
+    //  If the sizes differ, each entry is moved to where its hash most likely belongs in this table, and
+    //  entries that land in the same cluster compete for slots using the usual replacement scheme.
+    //  When growing the table, an entry's true cluster is one of several that it could have come from, so only some of them will be found again.
+    template <typename Layout>
+    void TranspositionTableBase<Layout>::ImportClusters(const Cluster* src, u64 srcCount, u8 srcAge, u16 srcGeneration) {
+#if defined(TT_STATS)
+        Shadow.Reset(Clusters, sizeof(Cluster) * ClusterCount, sizeof(Entry));
+#endif
+
+        if (srcCount == ClusterCount) {
+            Age = srcAge;
+            Generation = srcGeneration;
+            RunParallel([&](i32 i, i32 numThreads) {
+                const u64 perThread = ClusterCount / static_cast<u64>(numThreads);
+                const u64 start = perThread * static_cast<u64>(i);
+                const u64 length = (i == numThreads - 1) ? ClusterCount - start : perThread;
+
+                std::memcpy(&Clusters[start], &src[start], sizeof(Cluster) * length);
+            });
+            return;
+        }
+
+        Clear();
+        Age = srcAge;
+
+        //  Threads own disjoint ranges of destination clusters, so no two of them write to the same one.
+        RunParallel([&](i32 i, i32 numThreads) {
+            const u64 perThread = ClusterCount / static_cast<u64>(numThreads);
+            const u64 dstStart = perThread * static_cast<u64>(i);
+            const u64 dstEnd = (i == numThreads - 1) ? ClusterCount : dstStart + perThread;
+
+            const u64 srcStart = FirstSourceFor(dstStart, srcCount, ClusterCount);
+            const u64 srcEnd = FirstSourceFor(dstEnd, srcCount, ClusterCount);
+
+            for (u64 s = srcStart; s < srcEnd; s++) {
+                if (src[s].Generation != srcGeneration)
+                    continue;
+
+                Cluster* const cluster = &Clusters[RescaleIndex(s, srcCount, ClusterCount)];
+                Refresh(cluster);
+                Entry* dst = &cluster->entries[0];
+
+                for (const auto& entry : src[s].entries) {
+                    if (entry.IsEmpty())
+                        continue;
+
+                    Entry* replace = &dst[0];
+                    for (i32 j = 0; j < Layout::EntriesPerCluster; j++) {
+                        if (dst[j].IsEmpty() || dst[j].Key == entry.Key) {
+                            replace = &dst[j];
+                            break;
+                        }
+
+                        if (replace->Quality(Age) > dst[j].Quality(Age))
+                            replace = &dst[j];
+                    }
+
+                    if (replace->IsEmpty() || replace->Key == entry.Key || replace->Quality(Age) < entry.Quality(Age))
+                        *replace = entry;
+                }
+            }
+        });
+    }
+
+    template <typename KeyType>
+    void TTEntryBase<KeyType>::Update(u64 key, i16 score, TTNodeType nodeType, i32 depth, Move move, i16 statEval, u8 age, bool isPV) {
+        const auto k = static_cast<KeyType>(key);
+
+#if defined(TT_TRACE)
+        if (TTTraceSink)
+            TTTraceSink->push_back({ key, score, statEval, move, static_cast<i8>(depth), TTAccess::Kind::Store, static_cast<u8>(nodeType), isPV });
+#endif
 
         if (move != Move::Null() || k != Key) {
             BestMove = move;
@@ -100,12 +664,99 @@ namespace Horsie {
             || k != Key
             || age != Age()
             || depth + (2 * isPV) > Depth() - 4) {
-            
-            Key = k;
-            SetScore(score);
-            SetStatEval(statEval);
-            _depth = static_cast<u8>(depth - DepthOffset);
-            _AgePVType = static_cast<u8>(age | ((isPV ? 1u : 0u) << 2) | static_cast<u32>(nodeType));
+
+#if defined(TT_STATS)
+            if (TTStatsSink) {
+                TTStatsSink->Writes++;
+                if (k != Key && !IsEmpty()) {
+                    (Depth() > depth ? TTStatsSink->ReplacedDeeper : TTStatsSink->ReplacedShallower)++;
+                    (age != Age() ? TTStatsSink->ReplacedOlder : TTStatsSink->ReplacedCurrent)++;
+                }
+            }
+#endif
+
+#if defined(TT_STATS)
+            if (TTShadowSink) {
+                if (u64* full = TTShadowSink->Find(this))
+                    *full = key;
+            }
+#endif
+
+            Set(key, score, nodeType, depth, BestMove, statEval, age, isPV);
+        }
+#if defined(TT_STATS)
+        else if (TTStatsSink) {
+            TTStatsSink->Writes++;
+            TTStatsSink->Rejected++;
+        }
+#endif
+    }
+
+    QSTable::~QSTable() {
+        AlignedFree(Entries);
+    }
+
+    void QSTable::Initialize(i32 kb) {
+        AlignedFree(Entries);
+        Entries = nullptr;
+
+        Count = u64(kb) * 1024 / sizeof(TTEntry);
+        if (Count == 0)
+            return;
+
+        Entries = AlignedAlloc<TTEntry>(Count);
+        Clear();
+    }
+
+    void QSTable::Clear() {
+        if (Entries)
+            std::memset(Entries, 0, sizeof(TTEntry) * Count);
+    }
+
+    TTStats& TTStats::operator+=(const TTStats& other) {
+        Probes += other.Probes;
+        Hits += other.Hits;
+        EmptySlots += other.EmptySlots;
+        FullClusterMisses += other.FullClusterMisses;
+        FalseHits += other.FalseHits;
+        Writes += other.Writes;
+        Rejected += other.Rejected;
+        ReplacedDeeper += other.ReplacedDeeper;
+        ReplacedShallower += other.ReplacedShallower;
+        ReplacedOlder += other.ReplacedOlder;
+        ReplacedCurrent += other.ReplacedCurrent;
+        QSProbes += other.QSProbes;
+        QSHits += other.QSHits;
+        return *this;
+    }
+
+    void TTStats::Print(std::ostream& os) const {
+        const auto pct = [](u64 n, u64 total) { return (total == 0) ? 0.0 : (100.0 * n / total); };
+        const auto replaced = ReplacedDeeper + ReplacedShallower;
+
+        os << std::fixed << std::setprecision(2);
+        os << "TT probes:      " << Probes << std::endl;
+        os << "  hits          " << Hits << " (" << pct(Hits, Probes) << "%)" << std::endl;
+        os << "  empty slots   " << EmptySlots << " (" << pct(EmptySlots, Probes) << "%)" << std::endl;
+        os << "  full misses   " << FullClusterMisses << " (" << pct(FullClusterMisses, Probes) << "%)" << std::endl;
+        os << "  false hits    " << FalseHits << " (" << pct(FalseHits, Hits) << "% of hits)" << std::endl;
+        os << "TT writes:      " << Writes << std::endl;
+        os << "  rejected      " << Rejected << " (" << pct(Rejected, Writes) << "%)" << std::endl;
+        os << "  replacements  " << replaced << " (" << pct(replaced, Writes) << "%)" << std::endl;
+        os << "    deeper      " << ReplacedDeeper << " (" << pct(ReplacedDeeper, replaced) << "%)" << std::endl;
+        os << "    shallower   " << ReplacedShallower << " (" << pct(ReplacedShallower, replaced) << "%)" << std::endl;
+        os << "    older age   " << ReplacedOlder << " (" << pct(ReplacedOlder, replaced) << "%)" << std::endl;
+        os << "    same age    " << ReplacedCurrent << " (" << pct(ReplacedCurrent, replaced) << "%)" << std::endl;
+
+        if (QSProbes != 0) {
+            os << "QS table probes: " << QSProbes << std::endl;
+            os << "  hits          " << QSHits << " (" << pct(QSHits, QSProbes) << "%)" << std::endl;
         }
+        os << std::defaultfloat;
     }
+
+    template struct TTEntryBase<TTLayout32::Key>;
+    template struct TTEntryBase<TTLayout64::Key>;
+    template class TranspositionTableBase<TTLayout32>;
+    template class TranspositionTableBase<TTLayout64>;
 }
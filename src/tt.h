@@ -1,9 +1,22 @@
 #pragma once
 
+#define TT_STATS 1
+#undef TT_STATS
+
+#define TT_TRACE 1
+#undef TT_TRACE
+
 #include "defs.h"
 #include "move.h"
+#include "util/alloc.h"
 
+#include <atomic>
 #include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #ifdef _MSC_VER
 #include <__msvc_int128.hpp>
@@ -24,11 +37,116 @@ namespace Horsie {
         Exact = Beta | Alpha
     };
 
-    struct TTEntry {
+    //  A layout describes how entries are packed into a cluster, which is always a whole fraction of a cache line.
+    //  The default packs 3 entries with 16 bit keys into 32 bytes. TT_CLUSTER_64 builds use a full cache line
+    //  with 5 entries and 32 bit keys instead, which costs 2 bytes per entry but makes false hits much rarer.
+    struct TTLayout32 {
+        using Key = u16;
+        static constexpr i32 EntriesPerCluster = 3;
+        static constexpr i32 ClusterBytes = 32;
+    };
+
+    struct TTLayout64 {
+        using Key = u32;
+        static constexpr i32 EntriesPerCluster = 5;
+        static constexpr i32 ClusterBytes = 64;
+    };
+
+#if defined(TT_CLUSTER_64)
+    using TTLayout = TTLayout64;
+#else
+    using TTLayout = TTLayout32;
+#endif
+
+
+    //  A single access to the TT, which is recorded while TTTraceSink is set so that the same
+    //  sequence of probes and stores can be replayed against other layouts (see tt_bench.h and tools/ttreplay.cpp).
+    //  Accesses are only recorded in builds with TT_TRACE defined, which keeps the check out of Probe and TTEntry::Update otherwise.
+    struct TTAccess {
+        enum class Kind : u8 { Probe, Store, NewSearch, Clear };
+
+        u64 Hash{};
+        i16 Score{};
+        i16 StatEval{};
+        Move BestMove{};
+        i8 Depth{};
+        Kind Type{};
+        u8 Bound{};
+        bool PV{};
+        /// The ply of the node that probed, which stores inherit from their probe in FillStorePlies
+        i16 Ply{};
+    };
+
+    static_assert(sizeof(TTAccess) == 24, "Unexpected TTAccess size");
+
+    inline thread_local std::vector<TTAccess>* TTTraceSink = nullptr;
+
+
+    //  Counters for what Probe and TTEntry::Update did, which are only collected in builds with TT_STATS defined.
+    //  Each SearchThread owns one and points TTStatsSink at it, and they are reset at the start of every search.
+    struct TTStats {
+        u64 Probes{};
+        /// Probes that found an entry with a matching key
+        u64 Hits{};
+        /// Probes that missed, but found an empty slot to use
+        u64 EmptySlots{};
+        /// Probes that missed in a full cluster, so one of the other positions' entries must be chosen for replacement
+        u64 FullClusterMisses{};
+        /// Hits on an entry whose key matched, but which was stored for a different position
+        u64 FalseHits{};
+
+        u64 Writes{};
+        /// Writes to an entry with the same key that were skipped, because the existing entry was deeper and from this search
+        u64 Rejected{};
+        u64 ReplacedDeeper{};
+        u64 ReplacedShallower{};
+        u64 ReplacedOlder{};
+        u64 ReplacedCurrent{};
+
+        /// Probes into the QSHash table, after a miss in the main table
+        u64 QSProbes{};
+        u64 QSHits{};
+
+        TTStats& operator+=(const TTStats& other);
+        void Print(std::ostream& os) const;
+    };
+
+    inline thread_local TTStats* TTStatsSink = nullptr;
+
+#if defined(TT_STATS)
+    //  The full hash of each entry in the search's table, which TT_STATS builds keep so that false hits can be counted.
+    //  An entry's hash is found by its offset from the first cluster, and is 0 if it isn't known, which is the case for
+    //  entries that were loaded or imported. Shared tables aren't tracked, since other processes write to them too.
+    struct TTShadowKeys {
+        uintptr_t Base = 0;
+        nuint Bytes = 0;
+        nuint EntryBytes = 1;
+        std::vector<u64> Keys{};
+
+        void Reset(const void* clusters, nuint bytes, nuint entryBytes) {
+            Base = reinterpret_cast<uintptr_t>(clusters);
+            Bytes = (clusters != nullptr) ? bytes : 0;
+            EntryBytes = entryBytes;
+            Keys.assign(Bytes / entryBytes + 1, 0);
+        }
+
+        u64* Find(const void* entry) {
+            const auto offset = reinterpret_cast<uintptr_t>(entry) - Base;
+            return (offset < Bytes) ? &Keys[offset / EntryBytes] : nullptr;
+        }
+    };
+
+    //  Points at the shadow keys of the table that this thread searches with, so that TTEntry::Update can record its stores.
+    inline thread_local TTShadowKeys* TTShadowSink = nullptr;
+#endif
+
+
+    template <typename KeyType>
+    struct TTEntryBase {
+        KeyType Key;    //  16 or 32 bits
         i16 _Score;     //  16 bits
         i16 _StatEval;  //  16 bits
         Move BestMove;  //  16 bits
-        u16 Key;        //  16 bits
         u8 _AgePVType;  //  5 + 2 + 1 bits
         u8 _depth;      //  8 bits
 
@@ -53,6 +171,16 @@ namespace Horsie {
 
         void Update(u64 key, i16 score, TTNodeType nodeType, i32 depth, Move move, i16 statEval, u8 age, bool isPV = false);
 
+        //  Writes every field, without the checks that Update makes to decide whether the existing entry is worth keeping.
+        constexpr void Set(u64 key, i16 score, TTNodeType nodeType, i32 depth, Move move, i16 statEval, u8 age, bool isPV) {
+            Key = static_cast<KeyType>(key);
+            SetScore(score);
+            SetStatEval(statEval);
+            BestMove = move;
+            SetDepth(depth);
+            _AgePVType = static_cast<u8>(age | ((isPV ? 1u : 0u) << 2) | static_cast<u32>(nodeType));
+        }
+
         static constexpr i32 DepthNone = -6;
         static constexpr i32 TT_AGE_INC = 0x8;
 
@@ -62,44 +190,148 @@ namespace Horsie {
         static constexpr i32 TT_AGE_MASK   = 0xF8;
         static constexpr i32 TT_AGE_CYCLE = 255 + TT_AGE_INC;
 
-        static constexpr i32 KeyShift = 64 - (sizeof(u16) * 8);
         static constexpr i32 DepthOffset = -7;
     };
 
+    static_assert(sizeof(TTEntryBase<u16>) == 10, "Unexpected TTEntry size");
+    static_assert(sizeof(TTEntryBase<u32>) == 12, "Unexpected TTEntry size");
+
 
-    struct alignas(32) TTCluster {
-        static constexpr i32 EntriesPerCluster = 3; 
-        
-        std::array<TTEntry, EntriesPerCluster> entries;
-        char _pad[2];
+    template <typename Layout>
+    struct alignas(Layout::ClusterBytes) TTClusterBase {
+        using Entry = TTEntryBase<typename Layout::Key>;
 
-        void Clear() {
-            std::memset(&entries[0], 0, sizeof(TTEntry) * EntriesPerCluster);
+        std::array<Entry, Layout::EntriesPerCluster> entries;
+
+        //  The table generation that this cluster's entries were written in.
+        //  Clusters from an older generation are treated as empty, which lets the table be cleared without touching it.
+        u16 Generation;
+
+        void Clear(u16 generation) {
+            std::memset(&entries[0], 0, sizeof(Entry) * Layout::EntriesPerCluster);
+            Generation = generation;
         }
     };
 
-    static_assert(sizeof(TTCluster) == 32, "Unexpected Cluster size");
+    static_assert(sizeof(TTClusterBase<TTLayout32>) == 32, "Unexpected Cluster size");
+    static_assert(sizeof(TTClusterBase<TTLayout64>) == 64, "Unexpected Cluster size");
 
 
-    class TranspositionTable {
+    template <typename Layout>
+    class TranspositionTableBase {
     public:
+        using Entry = TTEntryBase<typename Layout::Key>;
+        using Cluster = TTClusterBase<Layout>;
+
+        ~TranspositionTableBase();
+
         void Initialize(i32 mb);
-        bool Probe(u64 hash, TTEntry*& tte) const;
+        void Resize(i32 mb);
+        bool Probe(u64 hash, Entry*& tte, i32 ply = 0);
         void Clear();
+        void ClearFull();
+        void PlaceClusters();
         u32 Hashfull() const;
+        u64 CountEntries(bool currentAgeOnly) const;
+        std::string AllocationInfo() const;
+        std::string NumaInfo() const;
 
-        void TTUpdate() {
-            Age += TTEntry::TT_AGE_INC;
-        }
+        //  Frees the clusters, or detaches from a shared table. Initialize or Resize allocates them again.
+        void Release();
 
-        TTCluster* GetCluster(u64 hash) const {
+        bool AttachShared(i32 id, i32 mb);
+        constexpr bool IsShared() const { return AllocKind == PageKind::Shared; }
+
+        bool Save(const std::string& path) const;
+        bool Load(const std::string& path);
+        void ImportClusters(const Cluster* src, u64 srcCount, u8 srcAge, u16 srcGeneration);
+
+        void TTUpdate();
+
+        Cluster* GetCluster(u64 hash) const {
             const auto offset = static_cast<u64>((static_cast<uint128_t>(hash) * static_cast<uint128_t>(ClusterCount)) >> 64);
             return &Clusters[offset];
         }
 
-        TTCluster* Clusters = nullptr;
+        //  Lazily finishes a Clear for this cluster if it hasn't been written since.
+        //  Threads can race here like they do on any other TT write: two of them can both see an old generation and clear the cluster,
+        //  and an entry that one of them stores in between can be lost. That costs at most one entry, so the generation is only
+        //  accessed with relaxed atomics to keep the check itself well defined. Generation doesn't change while a search is running.
+        void Refresh(Cluster* cluster) {
+            auto generation = std::atomic_ref<u16>(cluster->Generation);
+            if (generation.load(std::memory_order::relaxed) != Generation) {
+                std::memset(&cluster->entries[0], 0, sizeof(Entry) * Layout::EntriesPerCluster);
+                generation.store(Generation, std::memory_order::relaxed);
+            }
+        }
+
+        Cluster* Clusters = nullptr;
         u8 Age = 0;
+        u16 Generation = 0;
         u64 ClusterCount = 0;
+        PageKind AllocKind = PageKind::Normal;
+
+#if defined(TT_STATS)
+        TTShadowKeys Shadow{};
+#endif
+
+        //  Runs a job(threadIndex, threadCount) on a set of worker threads, which the SearchThreadPool points at its own threads.
+        //  If this isn't set, Clear starts temporary threads instead.
+        std::function<void(const std::function<void(i32, i32)>&)> Executor;
+
+    private:
+        void RunParallel(const std::function<void(i32, i32)>& job) const;
+        std::pair<u64, u64> Slice(i32 i, i32 numThreads) const;
+
+        //  The start of the mapping when the table is shared, which begins with a SharedHeader.
+        void* SharedBase = nullptr;
+        std::string SharedName{};
+    };
+
+    using TTEntry = TTEntryBase<TTLayout::Key>;
+    using TTCluster = TTClusterBase<TTLayout>;
+    using TranspositionTable = TranspositionTableBase<TTLayout>;
+
+
+    //  A small per-thread table for QSearch and static eval only entries, enabled by setting QSHash (in KB).
+    //  Keeping these out of the main table stops them from pushing deeper entries out of its clusters,
+    //  and QSHash is capped at a few MB so that the table can stay in the thread's own cache.
+    //  Each slot holds a single entry, and Store always replaces it instead of going through TTEntry::Update.
+    //  Its effect on the main table's hit rate is printed by bench and ttstats in builds with TT_STATS defined in tt.h,
+    //  which can be compared between runs with QSHash at 0 and at the size being tested.
+    class QSTable {
+    public:
+        ~QSTable();
+
+        void Initialize(i32 kb);
+        void Clear();
+
+        constexpr bool Enabled() const { return Count != 0; }
+
+        bool Probe(u64 hash, TTEntry*& tte) const {
+            const auto offset = static_cast<u64>((static_cast<uint128_t>(hash) * static_cast<uint128_t>(Count)) >> 64);
+            tte = &Entries[offset];
+
+            const bool hit = !tte->IsEmpty() && tte->Key == static_cast<TTLayout::Key>(hash);
+
+#if defined(TT_STATS)
+            if (TTStatsSink) {
+                TTStatsSink->QSProbes++;
+                TTStatsSink->QSHits += hit;
+            }
+#endif
+
+            return hit;
+        }
+
+        //  The best move is kept if the new one is null and the slot already held this position, like TTEntry::Update does.
+        static void Store(TTEntry* tte, u64 hash, i16 score, TTNodeType nodeType, i32 depth, Move move, i16 statEval, u8 age, bool isPV) {
+            const bool samePosition = !tte->IsEmpty() && tte->Key == static_cast<TTLayout::Key>(hash);
+            tte->Set(hash, score, nodeType, depth, (move == Move::Null() && samePosition) ? tte->BestMove : move, statEval, age, isPV);
+        }
+
+        TTEntry* Entries = nullptr;
+        u64 Count = 0;
     };
 
 }
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "defs.h"
+#include "position.h"
+#include "search.h"
+#include "threadpool.h"
+#include "tt.h"
+#include "tt_trace.h"
+#include "util.h"
+#include "util/timer.h"
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace Horsie::Search;
+
+namespace Horsie {
+
+    struct TTReplayResult {
+        u64 Probes{};
+        u64 Hits{};
+        u64 FalseHits{};
+        u64 Operations{};
+        i64 Millis{};
+    };
+
+    //  Plays back a recorded sequence of TT accesses against a fresh table with the given layout.
+    //  Stores go through a normal Probe first, since that is how search finds the entry to update.
+    //  If shadowKeys is true, the full 64 bit hash of every stored entry is kept on the side so that
+    //  hits on entries belonging to a different position can be counted.
+    template <typename Layout>
+    inline TTReplayResult ReplayTTTrace(const std::vector<TTAccess>& trace, i32 mb, bool shadowKeys) {
+        using Table = TranspositionTableBase<Layout>;
+        using Entry = typename Table::Entry;
+
+        Table tt{};
+        tt.Initialize(mb);
+
+        std::vector<u64> shadow{};
+        if (shadowKeys)
+            shadow.resize(tt.ClusterCount * Layout::EntriesPerCluster);
+
+        const auto slotOf = [&](const Entry* tte) {
+            const auto cluster = (reinterpret_cast<const char*>(tte) - reinterpret_cast<const char*>(tt.Clusters)) / sizeof(typename Table::Cluster);
+            return static_cast<u64>(cluster) * Layout::EntriesPerCluster + static_cast<u64>(tte - &tt.Clusters[cluster].entries[0]);
+        };
+
+        TTReplayResult result{};
+        Entry* tte = nullptr;
+
+        const auto startTime = Timepoint::Now();
+        for (const auto& op : trace) {
+            switch (op.Type) {
+            case TTAccess::Kind::Probe: {
+                result.Probes++;
+                if (tt.Probe(op.Hash, tte)) {
+                    result.Hits++;
+
+                    if (shadowKeys && shadow[slotOf(tte)] != op.Hash)
+                        result.FalseHits++;
+                }
+                break;
+            }
+            case TTAccess::Kind::Store: {
+                tt.Probe(op.Hash, tte);
+                tte->Update(op.Hash, op.Score, static_cast<TTNodeType>(op.Bound), op.Depth, op.BestMove, op.StatEval, tt.Age, op.PV);
+
+                if (shadowKeys)
+                    shadow[slotOf(tte)] = op.Hash;
+                break;
+            }
+            case TTAccess::Kind::NewSearch:
+                tt.TTUpdate();
+                break;
+            case TTAccess::Kind::Clear:
+                tt.Clear();
+                std::fill(shadow.begin(), shadow.end(), 0);
+                break;
+            }
+        }
+
+        result.Operations = trace.size();
+        result.Millis = Timepoint::TimeSince(startTime);
+        return result;
+    }
+
+    template <typename Layout>
+    inline void PrintTTReplay(const std::vector<TTAccess>& trace, i32 mb, const std::string& name) {
+        //  Time a run without the shadow keys so that their bookkeeping doesn't count against the table.
+        const auto timed = ReplayTTTrace<Layout>(trace, mb, false);
+        const auto stats = ReplayTTTrace<Layout>(trace, mb, true);
+
+        const auto probes = static_cast<double>(std::max<u64>(stats.Probes, 1));
+        const auto opsPerSec = static_cast<u64>(timed.Operations / (std::max<i64>(timed.Millis, 1) / 1000.0));
+
+        std::cout << std::left << std::setw(10) << name
+                  << std::setw(10) << Layout::EntriesPerCluster
+                  << std::setw(10) << (sizeof(typename Layout::Key) * 8)
+                  << std::setw(12) << std::fixed << std::setprecision(2) << (100.0 * stats.Hits / probes)
+                  << std::setw(14) << std::setprecision(4) << (100.0 * stats.FalseHits / probes)
+                  << FormatWithCommas(opsPerSec) << std::endl;
+    }
+
+    //  Runs the bench positions while recording every TT access made by every thread.
+    //  Helper threads' accesses are appended after the main thread's, so with more than one thread
+    //  the trace sees them in a different order than the search did.
+    inline std::vector<TTAccess> RecordBenchTrace(SearchThreadPool& SearchPool, i32 depth, u64& totalNodes, i64& duration) {
+        Position pos = Position(InitialFEN);
+        SearchThread* thread = SearchPool.MainThread();
+
+        auto odf = thread->OnDepthFinish;
+        auto osf = thread->OnSearchFinish;
+        thread->OnDepthFinish = []() {};
+        thread->OnSearchFinish = []() {};
+
+        SearchLimits limits;
+        limits.MaxDepth = depth;
+        limits.MaxSearchTime = INT32_MAX;
+
+        std::vector<std::vector<TTAccess>> traces(SearchPool.Threads.size());
+        SearchPool.RunOnAllThreads([&](i32 i, i32) { TTTraceSink = &traces[i]; });
+
+        totalNodes = 0;
+        SearchPool.TTable.Clear();
+        SearchPool.Clear();
+
+        const auto startTime = Timepoint::Now();
+        for (std::string fen : BenchFENs) {
+            pos.LoadFromFEN(fen);
+
+            SearchPool.StartSearch(pos, limits);
+            SearchPool.WaitForMain();
+            totalNodes += SearchPool.GetNodeCount();
+
+            SearchPool.TTable.Clear();
+            SearchPool.Clear();
+            traces[0].push_back({ .Type = TTAccess::Kind::Clear });
+        }
+        duration = Timepoint::TimeSince(startTime);
+
+        SearchPool.RunOnAllThreads([](i32, i32) { TTTraceSink = nullptr; });
+
+        thread->OnDepthFinish = odf;
+        thread->OnSearchFinish = osf;
+
+        for (auto& t : traces)
+            FillStorePlies(t);
+
+        std::vector<TTAccess> trace = std::move(traces[0]);
+        for (size_t i = 1; i < traces.size(); i++)
+            trace.insert(trace.end(), traces[i].begin(), traces[i].end());
+
+        return trace;
+    }
+
+    //  Replays a bench trace against each cluster layout, so that their hit rates are compared on the same workload.
+    //  Replay ops/sec is how quickly a single thread gets through the trace's probes and stores on each table, which shows
+    //  the cost of the table itself but not of searching with it. A build can only search with its own layout, so the
+    //  search NPS of the two layouts is compared by building both of them with "make tt-layouts".
+    //  The main table is freed while the replays run so that only one Hash sized table is allocated at a time.
+    inline void DoTTBench(SearchThreadPool& SearchPool, i32 depth) {
+        u64 totalNodes = 0;
+        i64 duration = 0;
+        const auto trace = RecordBenchTrace(SearchPool, depth, totalNodes, duration);
+
+        std::cout << "Recorded " << FormatWithCommas(trace.size()) << " TT accesses over " << FormatWithCommas(totalNodes) << " nodes" << std::endl << std::endl;
+
+        std::cout << std::left << std::setw(10) << "Cluster" << std::setw(10) << "Entries" << std::setw(10) << "Key bits"
+                  << std::setw(12) << "Hit %" << std::setw(14) << "False hit %" << "Replay ops/sec" << std::endl;
+
+        const bool shared = SearchPool.TTable.IsShared();
+        if (!shared)
+            SearchPool.TTable.Release();
+
+        PrintTTReplay<TTLayout32>(trace, Horsie::Hash, "32 byte");
+        PrintTTReplay<TTLayout64>(trace, Horsie::Hash, "64 byte");
+
+        if (!shared)
+            SearchPool.TTable.Initialize(Horsie::Hash);
+    }
+
+    //  Records a bench trace to a file that can be replayed offline with the ttreplay tool.
+    inline void DoTTTrace(SearchThreadPool& SearchPool, const std::string& path, i32 depth) {
+        u64 totalNodes = 0;
+        i64 duration = 0;
+        const auto trace = RecordBenchTrace(SearchPool, depth, totalNodes, duration);
+
+        if (!WriteTTTrace(path, trace)) {
+            std::cout << "info string Failed to write TT trace to " << path << std::endl;
+            return;
+        }
+
+        std::cout << "Wrote " << FormatWithCommas(trace.size()) << " TT accesses over " << FormatWithCommas(totalNodes)
+                  << " nodes to " << path << " (" << FormatWithCommas(sizeof(TTTraceHeader) + trace.size() * sizeof(TTAccess)) << " bytes)" << std::endl;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "defs.h"
+#include "tt.h"
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Horsie {
+
+    //  Trace files start with this header, and are followed by Count TTAccess records.
+    struct TTTraceHeader {
+        u64 Magic;
+        u32 Version;
+        u32 RecordSize;
+        u64 Count;
+    };
+
+    constexpr u64 TTTraceMagic = 0x48545454'52414345;  //  "HTTTRACE"
+    constexpr u32 TTTraceVersion = 1;
+
+    //  The TT only sees a ply when it is probed, so stores are given the ply of the latest probe of the same hash,
+    //  which is the node that is storing its result. This has to be done per thread, before traces are merged.
+    inline void FillStorePlies(std::vector<TTAccess>& trace) {
+        std::unordered_map<u64, i16> plies{};
+
+        for (auto& op : trace) {
+            if (op.Type == TTAccess::Kind::Probe) {
+                plies[op.Hash] = op.Ply;
+            }
+            else if (op.Type == TTAccess::Kind::Store) {
+                const auto it = plies.find(op.Hash);
+                op.Ply = (it != plies.end()) ? it->second : 0;
+            }
+            else if (op.Type == TTAccess::Kind::Clear) {
+                plies.clear();
+            }
+        }
+    }
+
+    inline bool WriteTTTrace(const std::string& path, const std::vector<TTAccess>& trace) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        const TTTraceHeader header{ TTTraceMagic, TTTraceVersion, sizeof(TTAccess), trace.size() };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(trace.data()), static_cast<std::streamsize>(sizeof(TTAccess) * trace.size()));
+        return file.good();
+    }
+
+    inline bool ReadTTTrace(const std::string& path, std::vector<TTAccess>& trace) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        TTTraceHeader header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || header.Magic != TTTraceMagic || header.Version != TTTraceVersion || header.RecordSize != sizeof(TTAccess))
+            return false;
+
+        trace.resize(header.Count);
+        file.read(reinterpret_cast<char*>(trace.data()), static_cast<std::streamsize>(sizeof(TTAccess) * header.Count));
+        return file.good();
+    }
+
+}
@@ -225,7 +225,7 @@ namespace Horsie {
 
 
     namespace NNUE {
-        struct Accumulator; 
+        template <typename Arch> struct Accumulator;
     }
 
     struct StateInfo {
@@ -3,6 +3,8 @@
 
 #include "cuckoo.h"
 #include "datagen/selfplay.h"
+#include "eval_batch.h"
+#include "genperm.h"
 #include "movegen.h"
 #include "nnue/nn.h"
 #include "position.h"
@@ -10,22 +12,18 @@
 #include "search_bench.h"
 #include "threadpool.h"
 #include "tt.h"
+#include "tt_bench.h"
 #include "util/timer.h"
 #include "zobrist.h"
 
 #include <chrono>
 #include <format>
+#include <iomanip>
 #include <iostream>
 #include <list>
 #include <optional>
 #include <thread>
 
-#if defined(PERM_COUNT)
-#include <fstream>
-#include <iostream>
-#include <vector>
-#endif
-
 using namespace Horsie;
 using namespace Horsie::Search;
 using namespace Horsie::NNUE;
@@ -89,6 +87,12 @@ namespace Horsie::UCI {
             else if (token == "eval")
                 HandleEvalCommand();
 
+            else if (token == "evalbatch")
+                HandleEvalBatchCommand(is);
+
+            else if (token == "evalparity")
+                HandleEvalParityCommand();
+
             else if (token == "wait")
                 HandleWaitCommand();
 
@@ -96,6 +100,9 @@ namespace Horsie::UCI {
             else if (token == "bench")
                 HandleBenchCommand(is);
 
+            else if (token == "smpbench")
+                HandleSMPBenchCommand(is);
+
             else if (token == "benchperft" || token == "b")
                 HandleBenchPerftCommand();
 
@@ -118,9 +125,27 @@ namespace Horsie::UCI {
             else if (token == "multipv")
                 HandleMultiPVCommand(is);
 
+            else if (token == "ttstats")
+                HandleTTStatsCommand();
+
+            else if (token == "ttbench")
+                HandleTTBenchCommand(is);
+
+            else if (token == "tttrace")
+                HandleTTTraceCommand(is);
+
+            else if (token == "exportnet")
+                HandleExportNetCommand(is);
+
+            else if (token == "savehash")
+                HandleSaveHashCommand(is);
+
+            else if (token == "loadhash")
+                HandleLoadHashCommand(is);
+
 
-            else if (token == "activations")
-                HandlePrintActivations();
+            else if (token == "genperm")
+                HandleGenPermCommand(is);
 
             else if (token == "tune")
                 HandleTuneCommand();
@@ -192,6 +217,9 @@ namespace Horsie::UCI {
         for (auto& opt : opts) {
             std::cout << opt << std::endl;
         }
+        std::cout << "option name EvalFile type string default <empty>" << std::endl;
+        std::cout << "option name SmallEvalFile type string default <empty>" << std::endl;
+        std::cout << "info string using " << NNUE::BuildTarget << " kernels" << std::endl;
         std::cout << "uciok" << std::endl;
         inUCI = true;
 
@@ -202,12 +230,24 @@ namespace Horsie::UCI {
         is >> rawName;
         is >> rawName;
 
-        is >> value;
         is >> value;
 
         std::string name = rawName;
         std::transform(name.begin(), name.end(), name.begin(), [](auto c) { return std::tolower(c); });
 
+        //  EvalFile and SmallEvalFile are the only string options, and paths may contain spaces.
+        if (name == "evalfile" || name == "smallevalfile") {
+            std::getline(is >> std::ws, value);
+            if (name == "evalfile")
+                HandleEvalFileOption(value == "<empty>" ? "" : value);
+            else
+                HandleSmallEvalFileOption(value == "<empty>" ? "" : value);
+
+            return;
+        }
+
+        is >> value;
+
         auto opt = FindUCIOption(name);
 
         if (!opt) return;
@@ -218,16 +258,115 @@ namespace Horsie::UCI {
 
         if (newVal < opt->MinValue || newVal > opt->MaxValue) return;
 
+        if (name == "hash" && SearchPool->TTable.IsShared()) {
+            std::cout << "info string hash is shared, set SharedHash to 0 before changing its size" << std::endl;
+            return;
+        }
+
         opt->CurrentValue = newVal;
 
         if (name == "hash") {
-            SearchPool->TTable.Initialize(Horsie::Hash.CurrentValue);
+            SearchPool->TTable.Resize(Horsie::Hash.CurrentValue);
             std::cout << "info string set hash to " << Horsie::Hash.CurrentValue << std::endl;
+            std::cout << "info string " << SearchPool->TTable.AllocationInfo() << std::endl;
+            std::cout << "info string " << SearchPool->TTable.NumaInfo() << std::endl;
         }
         else if (name == "threads") {
             SearchPool->Resize(Horsie::Threads.CurrentValue);
             std::cout << "info string set threads to " << Horsie::Threads.CurrentValue << std::endl;
+            UpdateNumaPlacement();
+        }
+        else if (name == "sharedhash") {
+            auto& tt = SearchPool->TTable;
+
+            if (Horsie::SharedHash == 0) {
+                if (tt.IsShared())
+                    tt.Initialize(Horsie::Hash);
+            }
+            else if (!tt.AttachShared(Horsie::SharedHash, Horsie::Hash)) {
+                std::cout << "info string failed to attach to shared hash " << Horsie::SharedHash.CurrentValue << std::endl;
+            }
+
+            std::cout << "info string " << tt.AllocationInfo() << std::endl;
+        }
+        else if (name == "qshash") {
+            SearchPool->ResizeQSTables();
+            std::cout << "info string set qs hash to " << Horsie::QSHash.CurrentValue << " KB per thread" << std::endl;
+        }
+        else if (name == "integerlayers") {
+            const bool active = NNUE::SetIntegerLayers(Horsie::IntegerLayers != 0);
+            if (Horsie::IntegerLayers != 0 && !active)
+                std::cout << "info string this network's weights don't fit the integer layers, using the float layers" << std::endl;
+            else
+                std::cout << "info string using the " << (active ? "integer" : "float") << " layers" << std::endl;
+
+            //  Evals that were cached with the other layers can be slightly different.
+            SearchPool->Clear();
+            SearchPool->TTable.Clear();
+        }
+        else if (name == "numapolicy") {
+            //  Recreate the threads so they pick up the new node bindings, then place the TT again.
+            SearchPool->Resize(Horsie::Threads.CurrentValue);
+            std::cout << "info string set numa policy to " << Horsie::NumaPolicy.CurrentValue << std::endl;
+            UpdateNumaPlacement();
+        }
+    }
+
+    void UCIClient::HandleEvalFileOption(const std::string& path) {
+        if (!NNUE::LoadNetworkFile(path)) {
+            std::cout << "info string failed to load network from " << path << std::endl;
+            return;
+        }
+
+        OnNetworkChanged();
+
+        if (Horsie::IntegerLayers != 0 && !NNUE::SetIntegerLayers(true))
+            std::cout << "info string this network's weights don't fit the integer layers, using the float layers" << std::endl;
+
+        if (path.empty())
+            std::cout << "info string using the embedded network" << std::endl;
+        else
+            std::cout << "info string using network " << path << (NNUE::IsNetworkMapped() ? " (mapped)" : " (copied)") << std::endl;
+
+        if (NNUE::MainNet.FTPairs != L1_PAIR_COUNT)
+            std::cout << "info string pruned the FT to " << NNUE::MainNet.FTPairs << " of " << L1_PAIR_COUNT << " neuron pairs" << std::endl;
+
+        std::cout << "info string using " << (NNUE::MainNet.FTWeights8 ? "i8" : "i16") << " FT weights" << std::endl;
+    }
+
+    void UCIClient::HandleSmallEvalFileOption(const std::string& path) {
+        if (!NNUE::LoadSmallNetworkFile(path)) {
+            std::cout << "info string failed to load small network from " << path << std::endl;
+            return;
+        }
+
+        OnNetworkChanged();
+
+        if (path.empty()) {
+            std::cout << "info string not using a small network" << std::endl;
+            return;
         }
+
+        std::cout << "info string using small network " << path << " with " << NNUE::SmallArch::L1_PAIR_COUNT << " neuron pairs"
+                  << " and " << (NNUE::SmallNet.FTWeights8 ? "i8" : "i16") << " FT weights" << std::endl;
+    }
+
+    void UCIClient::OnNetworkChanged() {
+        //  Everything computed with the previous network is now stale.
+        pos.ResetAccumulators();
+
+        SearchPool->Clear();
+        SearchPool->TTable.Clear();
+    }
+
+    void UCIClient::HandleExportNetCommand(std::istringstream& is) {
+        std::string path{};
+        std::getline(is >> std::ws, path);
+
+        if (NNUE::ExportNetwork(path))
+            std::cout << "info string exported network for " << NNUE::SIMDTarget << " to " << path << std::endl;
+        else
+            std::cout << "info string failed to export network to " << path << std::endl;
     }
 
     void UCIClient::HandleNewGameCommand() {
@@ -307,6 +446,21 @@ namespace Horsie::UCI {
         std::cout << NNUE::GetEvaluation(pos) << std::endl;
     }
 
+    void UCIClient::HandleEvalBatchCommand(std::istringstream& is) {
+        std::string input{}, output{};
+        is >> input >> output;
+        if (input.empty() || output.empty()) {
+            std::cout << "info string usage: evalbatch <input> <output>" << std::endl;
+            return;
+        }
+
+        DoEvalBatch(*SearchPool, input, output);
+    }
+
+    void UCIClient::HandleEvalParityCommand() {
+        DoEvalParity(Horsie::IntegerLayers != 0);
+    }
+
     void UCIClient::HandleWaitCommand() {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
@@ -317,6 +471,11 @@ namespace Horsie::UCI {
         Horsie::DoBench(*SearchPool, depth);
     }
 
+    void UCIClient::HandleSMPBenchCommand(std::istringstream& is) {
+        i32 depth = ReadMaybe<i32>(is).value_or(12);
+        DoSMPBench(*SearchPool, depth);
+    }
+
     void UCIClient::HandleBenchPerftCommand() {
         const auto startTime = Timepoint::Now();
 
@@ -401,65 +560,123 @@ namespace Horsie::UCI {
         if (Horsie::Threads.TrySet(cnt)) {
             SearchPool->Resize(Horsie::Threads);
             std::cout << "info string set threads to " << cnt << std::endl;
+            UpdateNumaPlacement();
         }
     }
 
     void UCIClient::HandleHashCommand(std::istringstream& is) {
         i32 cnt = ReadMaybe<i32>(is).value_or(Horsie::Hash.DefaultValue);
 
+        if (SearchPool->TTable.IsShared()) {
+            std::cout << "info string hash is shared, set SharedHash to 0 before changing its size" << std::endl;
+            return;
+        }
+
         if (Horsie::Hash.TrySet(cnt)) {
-            SearchPool->TTable.Initialize(cnt);
+            SearchPool->TTable.Resize(cnt);
             std::cout << "info string set hash to " << cnt << std::endl;
+            std::cout << "info string " << SearchPool->TTable.AllocationInfo() << std::endl;
+            std::cout << "info string " << SearchPool->TTable.NumaInfo() << std::endl;
         }
     }
 
-    void UCIClient::HandleMultiPVCommand(std::istringstream& is) {
-        i32 cnt = ReadMaybe<i32>(is).value_or(Horsie::MultiPV.DefaultValue);
+    void UCIClient::HandleTTStatsCommand() {
+        const auto& tt = SearchPool->TTable;
+        const u64 capacity = tt.ClusterCount * TTLayout::EntriesPerCluster;
+        const u64 entries = tt.CountEntries(false);
+        const u64 current = tt.CountEntries(true);
 
-        if (Horsie::MultiPV.TrySet(cnt)) {
-            std::cout << "info string set multipv to " << cnt << std::endl;
-        }
+        std::cout << "TT entries:     " << entries << " / " << capacity << " (" << std::fixed << std::setprecision(2) << (100.0 * entries / capacity) << "%), "
+                  << current << " from the current age" << std::defaultfloat << std::endl;
+
+#if defined(TT_STATS)
+        SearchPool->GetTTStats().Print(std::cout);
+#else
+        std::cout << "Probe and write counters are only collected if TT_STATS is defined in tt.h" << std::endl;
+#endif
     }
 
+    void UCIClient::HandleTTBenchCommand(std::istringstream& is) {
+#if !defined(TT_TRACE)
+        std::cout << "TT accesses are only recorded if TT_TRACE is defined in tt.h" << std::endl;
+        return;
+#endif
 
-    void UCIClient::HandlePrintActivations() {
-#if defined(PERM_COUNT)
-        std::ofstream file("perm.txt");
-        for (size_t i = 0; i < NNZCounts.size(); ++i) {
-            file << i << " " << NNZCounts[i] << "\n";
+        i32 depth = ReadMaybe<i32>(is).value_or(8);
+        DoTTBench(*SearchPool, depth);
+    }
+
+    void UCIClient::HandleTTTraceCommand(std::istringstream& is) {
+#if !defined(TT_TRACE)
+        std::cout << "TT accesses are only recorded if TT_TRACE is defined in tt.h" << std::endl;
+        return;
+#endif
+
+        std::string path{};
+        is >> path;
+        if (path.empty()) {
+            std::cout << "info string usage: tttrace <file> [depth]" << std::endl;
+            return;
         }
-        file.close();
 
-        std::cout << ActivationCount << " / " << EvalCalls << " = " << ((double)ActivationCount / EvalCalls) << std::endl;
+        i32 depth = ReadMaybe<i32>(is).value_or(8);
+        DoTTTrace(*SearchPool, path, depth);
+    }
+
+    void UCIClient::HandleSaveHashCommand(std::istringstream& is) {
+        std::string path{};
+        std::getline(is >> std::ws, path);
 
-        std::vector<std::pair<size_t, uint64_t>> indexedCounts;
+        if (SearchPool->TTable.Save(path))
+            std::cout << "info string saved hash to " << path << std::endl;
+        else
+            std::cout << "info string failed to save hash to " << path << std::endl;
+    }
+
+    void UCIClient::HandleLoadHashCommand(std::istringstream& is) {
+        std::string path{};
+        std::getline(is >> std::ws, path);
 
-        // Create the index-value pairs
-        for (size_t i = 0; i < NNZCounts.size(); ++i) {
-            indexedCounts.emplace_back(i, NNZCounts[i]);
+        if (SearchPool->TTable.IsShared()) {
+            std::cout << "info string hash is shared, set SharedHash to 0 before loading a snapshot" << std::endl;
+            return;
         }
 
-        // Filter pairs where index is less than L1_SIZE / 2
-        indexedCounts.erase(
-            std::remove_if(indexedCounts.begin(), indexedCounts.end(), [&](const auto& pair) { return pair.first >= L1_SIZE / 2; }), indexedCounts.end());
+        if (SearchPool->TTable.Load(path))
+            std::cout << "info string loaded hash from " << path << std::endl;
+        else
+            std::cout << "info string failed to load hash from " << path << std::endl;
+    }
 
-        // Sort by value in descending order
-        std::sort(indexedCounts.begin(), indexedCounts.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    void UCIClient::UpdateNumaPlacement() {
+        //  This also resets the TT's memory policy when NumaPolicy goes back to None.
+        SearchPool->TTable.PlaceClusters();
+        if (Horsie::NumaPolicy.CurrentValue == 0)
+            return;
 
-        std::vector<size_t> indices;
-        std::transform(indexedCounts.begin(), indexedCounts.end(), std::back_inserter(indices), [](const auto& pair) { return pair.first; });
+        std::cout << "info string " << SearchPool->TTable.NumaInfo() << std::endl;
+    }
 
-        // Chunk the indices into groups of 16 and print
-        const size_t chunkSize = 16;
-        for (size_t i = 0; i < indices.size(); i += chunkSize) {
-            std::ostringstream oss;
-            for (size_t j = i; j < i + chunkSize && j < indices.size(); ++j) {
-                if (j > i) oss << ", ";
-                oss << indices[j];
-            }
-            std::cout << oss.str() << ",\n";
+    void UCIClient::HandleMultiPVCommand(std::istringstream& is) {
+        i32 cnt = ReadMaybe<i32>(is).value_or(Horsie::MultiPV.DefaultValue);
+
+        if (Horsie::MultiPV.TrySet(cnt)) {
+            std::cout << "info string set multipv to " << cnt << std::endl;
         }
-#endif
+    }
+
+
+    void UCIClient::HandleGenPermCommand(std::istringstream& is) {
+        i32 depth = ReadMaybe<i32>(is).value_or(12);
+
+        std::string path{};
+        std::getline(is >> std::ws, path);
+        if (path.empty())
+            path = NNUE::NetworkName().empty() ? "perm.txt" : NNUE::NetworkName() + ".perm";
+
+        //  The accumulators were computed with the previous order, and the benches leave the TT filled.
+        DoGenPerm(*SearchPool, depth, path);
+        OnNetworkChanged();
     }
 
     void UCIClient::HandleTuneCommand() {
@@ -33,9 +33,12 @@ namespace Horsie::UCI {
 
         void HandleDisplayPosition();
         void HandleEvalCommand();
+        void HandleEvalBatchCommand(std::istringstream& is);
+        void HandleEvalParityCommand();
         void HandleWaitCommand();
         
         void HandleBenchCommand(std::istringstream& is);
+        void HandleSMPBenchCommand(std::istringstream& is);
         void HandleBenchPerftCommand();
         void HandlePerftCommand(std::istringstream& is);
         void HandleListMovesCommand();
@@ -44,8 +47,18 @@ namespace Horsie::UCI {
         void HandleThreadsCommand(std::istringstream& is);
         void HandleHashCommand(std::istringstream& is);
         void HandleMultiPVCommand(std::istringstream& is);
+        void UpdateNumaPlacement();
+        void HandleEvalFileOption(const std::string& path);
+        void HandleSmallEvalFileOption(const std::string& path);
+        void OnNetworkChanged();
+        void HandleExportNetCommand(std::istringstream& is);
+        void HandleTTStatsCommand();
+        void HandleTTBenchCommand(std::istringstream& is);
+        void HandleTTTraceCommand(std::istringstream& is);
+        void HandleSaveHashCommand(std::istringstream& is);
+        void HandleLoadHashCommand(std::istringstream& is);
 
-        void HandlePrintActivations();
+        void HandleGenPermCommand(std::istringstream& is);
         void HandleTuneCommand();
 
         void HandleDatagenCommand(std::istringstream& is);
@@ -3,7 +3,39 @@
 #include "../defs.h"
 #include "../types.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
 namespace Horsie {
+
+    constexpr nuint HugePageSize = 2 * 1024 * 1024;
+
+    enum class PageKind {
+        Normal,
+        /// Transparent huge pages, requested with madvise(MADV_HUGEPAGE)
+        Transparent,
+        /// Explicit huge pages from hugetlbfs (MAP_HUGETLB)
+        HugeTLB,
+        /// A named POSIX shared memory segment, which is shared with other processes
+        Shared
+    };
+
+    inline const char* PageKindName(PageKind kind) {
+        switch (kind) {
+        case PageKind::Transparent: return "transparent huge pages";
+        case PageKind::HugeTLB: return "hugetlbfs huge pages";
+        case PageKind::Shared: return "a shared memory segment";
+        default: return "normal pages";
+        }
+    }
+
     template <typename T>
     inline auto AlignedAlloc(nuint items, nuint alignment = AllocAlignment) {
         nuint bytes = ((nuint)sizeof(T) * (nuint)items);
@@ -25,4 +57,97 @@ namespace Horsie {
         std::free(ptr);
 #endif
     }
+
+    constexpr nuint RoundToHugePage(nuint bytes) {
+        return ((bytes + HugePageSize - 1) / HugePageSize) * HugePageSize;
+    }
+
+    //  Allocates memory for large tables like the TT, preferring huge pages to cut down on TLB misses.
+    //  Tries explicit hugetlbfs pages first, then 2 MB aligned memory with madvise(MADV_HUGEPAGE),
+    //  and falls back to a regular aligned allocation. The kind of memory that was used is written to 'kind',
+    //  and the same kind must be passed to LargePageFree.
+    template <typename T>
+    inline T* LargePageAlloc(nuint items, PageKind& kind) {
+        const nuint bytes = sizeof(T) * items;
+
+#if defined(__linux__)
+        const nuint rounded = RoundToHugePage(bytes);
+        void* mem = nullptr;
+
+#if defined(MAP_HUGETLB)
+        mem = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            kind = PageKind::HugeTLB;
+            return static_cast<T*>(mem);
+        }
+#endif
+
+        mem = std::aligned_alloc(HugePageSize, rounded);
+        if (mem) {
+#if defined(MADV_HUGEPAGE)
+            kind = (madvise(mem, rounded, MADV_HUGEPAGE) == 0) ? PageKind::Transparent : PageKind::Normal;
+#else
+            kind = PageKind::Normal;
+#endif
+            return static_cast<T*>(mem);
+        }
+#endif
+
+        kind = PageKind::Normal;
+        return AlignedAlloc<T>(items);
+    }
+
+    inline void LargePageFree(void* ptr, nuint bytes, PageKind kind) {
+        if (!ptr)
+            return;
+
+#if defined(__linux__)
+        if (kind == PageKind::HugeTLB) {
+            munmap(ptr, RoundToHugePage(bytes));
+            return;
+        }
+#endif
+
+        AlignedFree(ptr);
+    }
+
+    //  Returns the number of bytes within [ptr, ptr + bytes) that the kernel has actually backed with
+    //  transparent huge pages, according to the AnonHugePages fields in /proc/self/smaps.
+    //  Returns 0 on other platforms, or if the information isn't available.
+    inline nuint TransparentHugeBytes(const void* ptr, nuint bytes) {
+        nuint total = 0;
+
+#if defined(__linux__)
+        std::ifstream smaps("/proc/self/smaps");
+        if (!smaps)
+            return 0;
+
+        const auto begin = reinterpret_cast<nuint>(ptr);
+        const auto end = begin + bytes;
+
+        bool inRange = false;
+        std::string line;
+        while (std::getline(smaps, line)) {
+            const auto dash = line.find('-');
+            const auto space = line.find(' ');
+
+            //  Mapping headers look like "7f1234500000-7f1234700000 rw-p ...".
+            if (dash != std::string::npos && space != std::string::npos && dash < space && line.find(':') > space) {
+                const nuint mapBegin = std::stoull(line.substr(0, dash), nullptr, 16);
+                const nuint mapEnd = std::stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16);
+                inRange = mapBegin < end && mapEnd > begin;
+                continue;
+            }
+
+            if (inRange && line.rfind("AnonHugePages:", 0) == 0) {
+                std::istringstream is(line.substr(14));
+                nuint kb = 0;
+                is >> kb;
+                total += kb * 1024;
+            }
+        }
+#endif
+
+        return std::min(total, bytes);
+    }
 }
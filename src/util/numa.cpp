@@ -0,0 +1,167 @@
+
+#include "numa.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Horsie::Numa {
+
+    namespace {
+
+        constexpr nuint BasePageSize = 4096;
+        constexpr nuint MaxPageSamples = 65536;
+        constexpr i32 MaxNodes = 1024;
+        constexpr i32 BitsPerMask = sizeof(unsigned long) * 8;
+
+        //  Parses lists like "0-15,32-47" from /sys/devices/system/node
+        std::vector<i32> ParseList(const std::string& str) {
+            std::vector<i32> values{};
+            std::stringstream ss(str);
+            std::string part;
+
+            while (std::getline(ss, part, ',')) {
+                if (part.empty() || !std::isdigit(static_cast<unsigned char>(part[0])))
+                    continue;
+
+                const auto dash = part.find('-');
+                const i32 lo = std::stoi(part.substr(0, dash));
+                const i32 hi = (dash == std::string::npos) ? lo : std::stoi(part.substr(dash + 1));
+
+                for (i32 i = lo; i <= hi; i++)
+                    values.push_back(i);
+            }
+
+            return values;
+        }
+
+        std::string ReadLine(const std::string& path) {
+            std::ifstream file(path);
+            std::string line{};
+            std::getline(file, line);
+            return line;
+        }
+
+        const std::vector<i32>& Nodes() {
+            static const auto nodes = [] {
+#if defined(__linux__)
+                auto list = ParseList(ReadLine("/sys/devices/system/node/online"));
+                if (!list.empty())
+                    return list;
+#endif
+                return std::vector<i32>{ 0 };
+            }();
+
+            return nodes;
+        }
+
+        //  Shrinks [ptr, ptr + bytes) inward to page boundaries, since mbind requires page aligned ranges.
+        std::pair<nuint, nuint> PageRange(const void* ptr, nuint bytes) {
+            const auto begin = (reinterpret_cast<nuint>(ptr) + BasePageSize - 1) & ~(BasePageSize - 1);
+            const auto end = (reinterpret_cast<nuint>(ptr) + bytes) & ~(BasePageSize - 1);
+            return { begin, std::max(begin, end) };
+        }
+
+#if defined(__linux__)
+        bool SetPolicy(void* ptr, nuint bytes, i32 mode, const std::vector<i32>& nodes, u32 flags = MPOL_MF_MOVE) {
+            const auto [begin, end] = PageRange(ptr, bytes);
+            if (begin == end)
+                return false;
+
+            unsigned long mask[MaxNodes / BitsPerMask] = {};
+            for (i32 node : nodes) {
+                if (node >= 0 && node < MaxNodes)
+                    mask[node / BitsPerMask] |= (1UL << (node % BitsPerMask));
+            }
+
+            const auto res = syscall(SYS_mbind, begin, end - begin, mode, mask, MaxNodes + 1, flags);
+            return res == 0;
+        }
+#endif
+    }
+
+
+    i32 NodeCount() {
+        return static_cast<i32>(Nodes().size());
+    }
+
+    bool BindThreadToNode(i32 node) {
+#if defined(__linux__)
+        const auto& nodes = Nodes();
+        const auto cpus = ParseList(ReadLine("/sys/devices/system/node/node" + std::to_string(nodes[node % nodes.size()]) + "/cpulist"));
+        if (cpus.empty())
+            return false;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (i32 cpu : cpus)
+            CPU_SET(cpu, &set);
+
+        return sched_setaffinity(0, sizeof(cpu_set_t), &set) == 0;
+#else
+        return false;
+#endif
+    }
+
+    bool Interleave(void* ptr, nuint bytes) {
+#if defined(__linux__)
+        return SetPolicy(ptr, bytes, MPOL_INTERLEAVE, Nodes());
+#else
+        return false;
+#endif
+    }
+
+    bool Prefer(void* ptr, nuint bytes, i32 node) {
+#if defined(__linux__)
+        const auto& nodes = Nodes();
+        return SetPolicy(ptr, bytes, MPOL_PREFERRED, { nodes[node % nodes.size()] });
+#else
+        return false;
+#endif
+    }
+
+    bool ResetPolicy(void* ptr, nuint bytes) {
+#if defined(__linux__)
+        return SetPolicy(ptr, bytes, MPOL_DEFAULT, {}, 0);
+#else
+        return false;
+#endif
+    }
+
+    std::vector<u64> PagesPerNode(const void* ptr, nuint bytes) {
+        const auto& nodes = Nodes();
+        std::vector<u64> counts(nodes.size(), 0);
+
+#if defined(__linux__)
+        const auto [begin, end] = PageRange(ptr, bytes);
+        const nuint pageCount = (end - begin) / BasePageSize;
+        if (pageCount == 0)
+            return counts;
+
+        const nuint stride = std::max<nuint>(1, pageCount / MaxPageSamples);
+        std::vector<void*> pages{};
+        for (nuint i = 0; i < pageCount; i += stride)
+            pages.push_back(reinterpret_cast<void*>(begin + i * BasePageSize));
+
+        std::vector<int> status(pages.size(), -1);
+        if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0)
+            return counts;
+
+        for (int node : status) {
+            const auto it = std::find(nodes.begin(), nodes.end(), node);
+            if (it != nodes.end())
+                counts[it - nodes.begin()] += stride;
+        }
+#endif
+
+        return counts;
+    }
+
+}
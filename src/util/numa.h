@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../defs.h"
+
+#include <string>
+#include <vector>
+
+namespace Horsie::Numa {
+
+    //  Values of the NumaPolicy UCI option.
+    enum class Policy {
+        //  Leave page placement and thread scheduling to the OS
+        None,
+        //  Spread the TT's pages evenly across all nodes
+        Interleave,
+        //  Each thread clears (and places) its own slice of the TT on its own node
+        Local
+    };
+
+    i32 NodeCount();
+
+    //  Pins the calling thread to the CPUs of the given node.
+    bool BindThreadToNode(i32 node);
+
+    //  Sets an interleaved memory policy on [ptr, ptr + bytes), migrating pages that were already touched.
+    bool Interleave(void* ptr, nuint bytes);
+
+    //  Sets a preferred memory policy for the given node on [ptr, ptr + bytes), migrating pages that were already touched.
+    bool Prefer(void* ptr, nuint bytes, i32 node);
+
+    //  Restores the default memory policy on [ptr, ptr + bytes). Pages that were already touched stay where they are.
+    bool ResetPolicy(void* ptr, nuint bytes);
+
+    //  Returns the number of resident pages of [ptr, ptr + bytes) on each node.
+    //  Large ranges are sampled, and the counts are scaled up to the full number of pages.
+    std::vector<u64> PagesPerNode(const void* ptr, nuint bytes);
+
+}